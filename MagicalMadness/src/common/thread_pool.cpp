@@ -0,0 +1,65 @@
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+thread_pool_t::thread_pool_t(std::size_t thread_count)
+{
+	if (!thread_count)
+		thread_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 2) - 1;
+
+	this->workers.reserve(thread_count);
+	for (std::size_t i = 0; i < thread_count; ++i)
+		this->workers.emplace_back(&thread_pool_t::worker_loop, this);
+}
+
+thread_pool_t::~thread_pool_t()
+{
+	{
+		std::lock_guard lock{ this->jobs_mutex };
+		this->stopping = true;
+	}
+
+	this->jobs_available.notify_all();
+	for (std::thread& worker : this->workers)
+		worker.join();
+}
+
+void thread_pool_t::worker_loop()
+{
+	while (true)
+	{
+		std::function<void()> job{};
+		{
+			std::unique_lock lock{ this->jobs_mutex };
+			this->jobs_available.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+
+			if (this->jobs.empty())
+				return; // stopping and nothing left to do
+
+			job = std::move(this->jobs.front());
+			this->jobs.pop_front();
+		}
+
+		job();
+	}
+}
+
+std::future<void> thread_pool_t::submit(std::function<void()> job)
+{
+	// std::function has to be copyable so the task is shared, the future reports completion (and rethrows anything the job threw).
+	std::shared_ptr<std::packaged_task<void()>> task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+	std::future<void> result = task->get_future();
+
+	{
+		std::lock_guard lock{ this->jobs_mutex };
+		this->jobs.emplace_back([task]() { (*task)(); });
+	}
+
+	this->jobs_available.notify_one();
+	return result;
+}
+
+std::size_t thread_pool_t::size() const
+{
+	return this->workers.size();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by everything that runs in the background (analysis, searches, ...).
+class thread_pool_t
+{
+private:
+	std::vector<std::thread> workers{};
+	std::deque<std::function<void()>> jobs{};
+	std::mutex jobs_mutex{};
+	std::condition_variable jobs_available{};
+	bool stopping = false;
+
+	void worker_loop();
+public:
+	thread_pool_t(std::size_t thread_count = 0); // 0 = one less than the core count (the UI thread keeps a core)
+	thread_pool_t(const thread_pool_t&) = delete;
+	~thread_pool_t(); // Finishes every queued job before returning
+
+	std::future<void> submit(std::function<void()> job);
+	std::size_t size() const;
+};
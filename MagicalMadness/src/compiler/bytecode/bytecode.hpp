@@ -0,0 +1,193 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "../interpreter/include/basetypes.hpp"
+
+// One byte per instruction, operands follow inline (u16 little endian unless noted).
+enum opcode_t : std::uint8_t
+{
+	OP_CONSTANT,	// [u16 constant] push a constant
+	OP_VOID,		// push void
+	OP_GET_GLOBAL,	// [u16 slot] push a variable, void if it was never assigned
+	OP_SET_GLOBAL,	// [u16 slot] assign the top of the stack, it stays there since assignments give back their value
+	OP_GET_LOCAL,	// [u16 slot] same as the global ones, for the running function's locals (they live on the stack)
+	OP_SET_LOCAL,
+	OP_POP,
+
+	OP_ADD,			// binary operators, same order as binary_operator_t
+	OP_SUBTRACT,
+	OP_MULTIPLY,
+	OP_DIVIDE,
+	OP_MODULO,
+	OP_POWER,
+	OP_AND,
+	OP_OR,
+	OP_XOR,
+	OP_SHIFT_LEFT,
+	OP_SHIFT_RIGHT,
+	OP_EQUAL,
+	OP_NOT_EQUAL,
+	OP_LESS,
+	OP_LESS_EQUAL,
+	OP_GREATER,
+	OP_GREATER_EQUAL,
+	OP_NOT,
+	OP_NEGATE,
+	OP_COMPLEMENT,
+
+	// Jump distances are u16 from the end of the instruction
+	OP_JUMP,				// [u16] forward
+	OP_JUMP_IF_FALSE,		// [u16] forward, pops the condition
+	OP_JUMP_IF_FALSE_OR_POP,// [u16] forward keeping the condition as the result (&&), pops it when not jumping
+	OP_JUMP_IF_TRUE_OR_POP,	// [u16] same for ||
+	OP_LOOP,				// [u16] backward
+	OP_LOOP_IF_TRUE,		// [u16] backward, pops the condition. Loops test at the bottom so every iteration is one jump
+
+	OP_FUNCTION,	// [u16 function] push a value of chunk_t::functions[function], linked to the environment
+	OP_CALL,		// [u8 argument count] stack holds function, arguments...
+	OP_TAIL_CALL,	// [u8 argument count] return f(...) in a function: a script function takes over the running call's frame, anything else is a normal call
+	OP_DUMP,		// pop and print a statement result
+	OP_RETURN		// pop the result (void if the stack is empty), go back to the caller or stop
+};
+
+const std::string opcode_strings[] = {
+	"CONSTANT",
+	"VOID",
+	"GET_GLOBAL",
+	"SET_GLOBAL",
+	"GET_LOCAL",
+	"SET_LOCAL",
+	"POP",
+	"ADD",
+	"SUBTRACT",
+	"MULTIPLY",
+	"DIVIDE",
+	"MODULO",
+	"POWER",
+	"AND",
+	"OR",
+	"XOR",
+	"SHIFT_LEFT",
+	"SHIFT_RIGHT",
+	"EQUAL",
+	"NOT_EQUAL",
+	"LESS",
+	"LESS_EQUAL",
+	"GREATER",
+	"GREATER_EQUAL",
+	"NOT",
+	"NEGATE",
+	"COMPLEMENT",
+	"JUMP",
+	"JUMP_IF_FALSE",
+	"JUMP_IF_FALSE_OR_POP",
+	"JUMP_IF_TRUE_OR_POP",
+	"LOOP",
+	"LOOP_IF_TRUE",
+	"FUNCTION",
+	"CALL",
+	"TAIL_CALL",
+	"DUMP",
+	"RETURN"
+};
+
+static_assert(OP_GREATER_EQUAL - OP_ADD == BINARY_GREATER_EQUAL, "binary opcodes must line up with binary_operator_t");
+
+// Compiled form of a program, everything the VM needs and nothing else.
+class chunk_t
+{
+public:
+	std::vector<std::uint8_t> code{};
+	std::vector<value_t> constants{};							// Strings are made once when compiling, running only adds a reference
+	std::vector<std::string> names{};							// Global slot -> name, for linking to the environment
+	std::vector<std::shared_ptr<const script_function_t>> functions{};	// Functions declared in here, each has its own chunk
+	std::size_t max_stack = 0;									// Deepest the operand stack gets, so the VM reserves once
+
+	void emit(opcode_t op)
+	{
+		code.push_back(op);
+	}
+
+	void emit(opcode_t op, std::uint16_t operand)
+	{
+		code.push_back(op);
+		code.push_back(static_cast<std::uint8_t>(operand & 0xFF));
+		code.push_back(static_cast<std::uint8_t>(operand >> 8));
+	}
+
+	std::uint16_t add_constant(value_t value)
+	{
+		if (constants.size() > UINT16_MAX)
+			throw std::runtime_error("Too many constants in one script!");
+
+		constants.push_back(std::move(value));
+		return static_cast<std::uint16_t>(constants.size() - 1);
+	}
+
+	void dump()
+	{
+		for (std::size_t ip = 0; ip < code.size();)
+		{
+			opcode_t op = static_cast<opcode_t>(code[ip]);
+			std::printf("%04zu %s", ip, opcode_strings[op].c_str());
+			++ip;
+
+			switch (op)
+			{
+				case OP_CONSTANT:
+				case OP_GET_GLOBAL:
+				case OP_SET_GLOBAL:
+				case OP_GET_LOCAL:
+				case OP_SET_LOCAL:
+				case OP_FUNCTION:
+				{
+					std::uint16_t operand = code[ip] | (code[ip + 1] << 8);
+					ip += 2;
+
+					if (op == OP_CONSTANT)
+					{
+						std::printf(" %u | ", operand);
+						constants[operand].dump();
+					}
+					else if (op == OP_GET_GLOBAL || op == OP_SET_GLOBAL)
+						std::printf(" %u | %s\n", operand, names[operand].c_str());
+					else if (op == OP_FUNCTION)
+						std::printf(" %u | %s\n", operand, functions[operand]->name.c_str());
+					else
+						std::printf(" %u\n", operand);
+					break;
+				}
+				case OP_JUMP:
+				case OP_JUMP_IF_FALSE:
+				case OP_JUMP_IF_FALSE_OR_POP:
+				case OP_JUMP_IF_TRUE_OR_POP:
+				case OP_LOOP:
+				case OP_LOOP_IF_TRUE:
+				{
+					std::uint16_t distance = code[ip] | (code[ip + 1] << 8);
+					ip += 2;
+
+					std::printf(" -> %04zu\n", op == OP_LOOP || op == OP_LOOP_IF_TRUE ? ip - distance : ip + distance);
+					break;
+				}
+				case OP_CALL:
+				case OP_TAIL_CALL:
+					std::printf(" %u\n", code[ip++]);
+					break;
+				default:
+					std::printf("\n");
+					break;
+			}
+		}
+
+		for (const std::shared_ptr<const script_function_t>& function : functions)
+		{
+			std::printf("\nfunction %s:\n", function->name.c_str());
+			function->chunk->dump();
+		}
+	}
+};
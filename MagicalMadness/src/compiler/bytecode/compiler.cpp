@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "compiler.hpp"
+
+void compiler_t::push(std::size_t count)
+{
+	depth += count;
+	chunk->max_stack = std::max(chunk->max_stack, depth);
+}
+
+void compiler_t::pop(std::size_t count)
+{
+	depth -= count;
+}
+
+std::size_t compiler_t::emit_jump(opcode_t op)
+{
+	chunk->emit(op, 0xFFFF);
+	return chunk->code.size() - 2;
+}
+
+void compiler_t::patch_jump(std::size_t operand)
+{
+	std::size_t distance = chunk->code.size() - (operand + 2);
+	if (distance > UINT16_MAX)
+		throw std::runtime_error("[Compiler] Too much code to jump over!");
+
+	chunk->code[operand] = static_cast<std::uint8_t>(distance & 0xFF);
+	chunk->code[operand + 1] = static_cast<std::uint8_t>(distance >> 8);
+}
+
+void compiler_t::patch_jumps(std::vector<std::size_t>& operands)
+{
+	for (std::size_t operand : operands)
+		patch_jump(operand);
+
+	operands.clear();
+}
+
+void compiler_t::emit_loop(opcode_t op, std::size_t target)
+{
+	std::size_t distance = chunk->code.size() + 3 - target;
+	if (distance > UINT16_MAX)
+		throw std::runtime_error("[Compiler] Loop body is too big!");
+
+	chunk->emit(op, static_cast<std::uint16_t>(distance));
+}
+
+void compiler_t::emit_store(const identifier_expr_t& identifier)
+{
+	chunk->emit(identifier.depth == 0 ? OP_SET_GLOBAL : OP_SET_LOCAL, static_cast<std::uint16_t>(identifier.slot));
+}
+
+void compiler_t::compile_primary(const primary_expr_t& primary)
+{
+	switch (primary.type)
+	{
+		case PRIMARY_NUMBER:
+		{
+			const number_expr_t& number = static_cast<const number_expr_t&>(primary);
+			chunk->emit(OP_CONSTANT, chunk->add_constant(number.value));
+			break;
+		}
+		case PRIMARY_INTEGER:
+		{
+			const integer_expr_t& integer = static_cast<const integer_expr_t&>(primary);
+			chunk->emit(OP_CONSTANT, chunk->add_constant(integer.value));
+			break;
+		}
+		case PRIMARY_STRING:
+		{
+			const string_expr_t& string = static_cast<const string_expr_t&>(primary);
+			chunk->emit(OP_CONSTANT, chunk->add_constant(value_t::make<runtime_string_t>(string.value)));
+			break;
+		}
+		case PRIMARY_IDENTIFIER:
+		{
+			const identifier_expr_t& identifier = static_cast<const identifier_expr_t&>(primary);
+			chunk->emit(identifier.depth == 0 ? OP_GET_GLOBAL : OP_GET_LOCAL, static_cast<std::uint16_t>(identifier.slot));
+			break;
+		}
+		default:
+			throw std::runtime_error("[Compiler] Unknown primary type!");
+	}
+
+	push();
+}
+
+// The whole chain (a + b + c ...) at once, see left_chain
+void compiler_t::compile_binary(const binary_expr_t& binary)
+{
+	std::vector<const stmt_t*> chain = left_chain<const stmt_t>(binary);
+	compile_node(*static_cast<const binary_expr_t*>(chain.front())->left);
+
+	for (const stmt_t* node : chain)
+	{
+		const binary_expr_t& link = static_cast<const binary_expr_t&>(*node);
+		compile_node(*link.right);
+
+		chunk->emit(static_cast<opcode_t>(OP_ADD + static_cast<int>(link.operand)));
+
+		pop(); // two in, one out
+	}
+}
+
+// Only one side ever ends up on the stack, the left one stays when it decides the result.
+void compiler_t::compile_logical(const logical_expr_t& logical)
+{
+	std::vector<const stmt_t*> chain = left_chain<const stmt_t>(logical);
+	compile_node(*static_cast<const logical_expr_t*>(chain.front())->left);
+
+	for (const stmt_t* node : chain)
+	{
+		const logical_expr_t& link = static_cast<const logical_expr_t&>(*node);
+		std::size_t end = emit_jump(link.is_and ? OP_JUMP_IF_FALSE_OR_POP : OP_JUMP_IF_TRUE_OR_POP);
+		pop();
+
+		compile_node(*link.right);
+		patch_jump(end);
+	}
+}
+
+void compiler_t::compile_call(const call_stmt_t& call, opcode_t op)
+{
+	if (call.arguments.size() > UINT8_MAX)
+		throw std::runtime_error("[Compiler] Too many arguments in call!");
+
+	compile_node(*call.function);
+	for (const ast_ptr_t<stmt_t>& argument : call.arguments)
+		compile_node(*argument);
+
+	chunk->emit(op);
+	chunk->code.push_back(static_cast<std::uint8_t>(call.arguments.size()));
+
+	pop(call.arguments.size()); // function slot is replaced by the result
+}
+
+void compiler_t::compile_assignment(const assignment_stmt_t& assignment)
+{
+	if (assignment.variable->type != EXPR_PRIMARY)
+		throw std::runtime_error("Attempt to assign a value to something that isn't a primary!");
+
+	const primary_expr_t& primary = static_cast<const primary_expr_t&>(*assignment.variable);
+	if (primary.type != PRIMARY_IDENTIFIER)
+		throw std::runtime_error("Attempt to assign a value to something that isn't a variable!");
+
+	compile_node(*assignment.assignment);
+	emit_store(static_cast<const identifier_expr_t&>(primary));
+}
+
+// Every node leaves exactly one value on the stack.
+void compiler_t::compile_node(const stmt_t& node)
+{
+	switch (node.type)
+	{
+		case STMT_ASSIGNMENT:
+			compile_assignment(static_cast<const assignment_stmt_t&>(node));
+			break;
+		case STMT_CALL:
+			compile_call(static_cast<const call_stmt_t&>(node));
+			break;
+		case EXPR_BINARY:
+			compile_binary(static_cast<const binary_expr_t&>(node));
+			break;
+		case EXPR_LOGICAL:
+			compile_logical(static_cast<const logical_expr_t&>(node));
+			break;
+		case EXPR_UNARY:
+			compile_node(*static_cast<const unary_expr_t&>(node).child);
+			chunk->emit(OP_NOT);
+			break;
+		case EXPR_NEGATE:
+			compile_node(*static_cast<const negate_expr_t&>(node).child);
+			chunk->emit(OP_NEGATE);
+			break;
+		case EXPR_COMPLEMENT:
+			compile_node(*static_cast<const complement_expr_t&>(node).child);
+			chunk->emit(OP_COMPLEMENT);
+			break;
+		case EXPR_PRIMARY:
+			compile_primary(static_cast<const primary_expr_t&>(node));
+			break;
+		default:
+			throw std::runtime_error("[Compiler] Unexpected statement: " + std::to_string(node.type));
+	}
+}
+
+void compiler_t::compile_body(const stmt_t& body)
+{
+	++nesting;
+	compile_statement(body);
+	--nesting;
+}
+
+// else if chains in a loop, every branch that has something after it jumps past the whole chain when it's done
+void compiler_t::compile_if(const if_stmt_t& root)
+{
+	std::vector<const if_stmt_t*> chain = if_chain(root);
+	const stmt_t* otherwise = chain.back()->else_branch.get();
+
+	std::vector<std::size_t> skip_rest{};
+	for (const if_stmt_t* branch : chain)
+	{
+		compile_node(*branch->condition);
+		std::size_t skip_then = emit_jump(OP_JUMP_IF_FALSE);
+		pop();
+
+		compile_body(*branch->then_branch);
+
+		if (branch != chain.back() || otherwise)
+			skip_rest.push_back(emit_jump(OP_JUMP));
+		patch_jump(skip_then);
+	}
+
+	if (otherwise)
+		compile_body(*otherwise);
+
+	for (std::size_t jump : skip_rest)
+		patch_jump(jump);
+}
+
+// Rotated so the condition sits under the body, after the first jump every iteration only takes the one OP_LOOP_IF_TRUE.
+//		JUMP condition
+//	body:
+//		...
+//	condition:
+//		...
+//		LOOP_IF_TRUE body
+void compiler_t::compile_while(const while_stmt_t& loop)
+{
+	std::size_t to_condition = emit_jump(OP_JUMP);
+	std::size_t body = chunk->code.size();
+
+	loops.emplace_back();
+	compile_body(*loop.body);
+
+	patch_jumps(loops.back().continues);
+	patch_jump(to_condition);
+
+	compile_node(*loop.condition);
+	emit_loop(OP_LOOP_IF_TRUE, body);
+	pop();
+
+	patch_jumps(loops.back().breaks);
+	loops.pop_back();
+}
+
+void compiler_t::compile_for(const for_stmt_t& loop)
+{
+	if (loop.initializer)
+	{
+		compile_node(*loop.initializer);
+		chunk->emit(OP_POP);
+		pop();
+	}
+
+	std::size_t to_condition = loop.condition ? emit_jump(OP_JUMP) : 0;
+	std::size_t body = chunk->code.size();
+
+	loops.emplace_back();
+	compile_body(*loop.body);
+
+	patch_jumps(loops.back().continues);
+	if (loop.step)
+	{
+		compile_node(*loop.step);
+		chunk->emit(OP_POP);
+		pop();
+	}
+
+	if (loop.condition)
+	{
+		patch_jump(to_condition);
+		compile_node(*loop.condition);
+		emit_loop(OP_LOOP_IF_TRUE, body);
+		pop();
+	}
+	else
+		emit_loop(OP_LOOP, body);
+
+	patch_jumps(loops.back().breaks);
+	loops.pop_back();
+}
+
+void compiler_t::compile_function(const function_stmt_t& declaration)
+{
+	if (chunk->functions.size() > UINT16_MAX)
+		throw std::runtime_error("[Compiler] Too many functions in one script!");
+
+	compiler_t function_compiler{};
+	declaration.function->chunk = function_compiler.compile(*declaration.function);
+
+	chunk->functions.push_back(declaration.function);
+	chunk->emit(OP_FUNCTION, static_cast<std::uint16_t>(chunk->functions.size() - 1));
+	push();
+
+	emit_store(static_cast<const identifier_expr_t&>(*declaration.variable));
+	chunk->emit(OP_POP);
+	pop();
+}
+
+void compiler_t::compile_return(const return_stmt_t& return_statement)
+{
+	// The return after it only runs when the callee didn't take the frame over (natives and machine code)
+	if (return_statement.value && in_function && return_statement.value->type == STMT_CALL)
+		compile_call(static_cast<const call_stmt_t&>(*return_statement.value), OP_TAIL_CALL);
+	else if (return_statement.value)
+		compile_node(*return_statement.value);
+	else
+		chunk->emit(OP_VOID);
+
+	push();
+	chunk->emit(OP_RETURN);
+	pop();
+}
+
+void compiler_t::compile_statement(const stmt_t& statement)
+{
+	switch (statement.type)
+	{
+		case STMT_BLOCK:
+		{
+			for (const ast_ptr_t<stmt_t>& child : static_cast<const block_stmt_t&>(statement).statements)
+				compile_body(*child);
+			break;
+		}
+		case STMT_IF:
+			compile_if(static_cast<const if_stmt_t&>(statement));
+			break;
+		case STMT_WHILE:
+			compile_while(static_cast<const while_stmt_t&>(statement));
+			break;
+		case STMT_FOR:
+			compile_for(static_cast<const for_stmt_t&>(statement));
+			break;
+		case STMT_FUNCTION:
+			compile_function(static_cast<const function_stmt_t&>(statement));
+			break;
+		case STMT_RETURN:
+			compile_return(static_cast<const return_stmt_t&>(statement));
+			break;
+		case STMT_BREAK:
+		case STMT_CONTINUE:
+		{
+			if (loops.empty())
+				throw std::runtime_error(statement.type == STMT_BREAK ? "break outside of a loop!" : "continue outside of a loop!");
+
+			std::size_t jump = emit_jump(OP_JUMP);
+			(statement.type == STMT_BREAK ? loops.back().breaks : loops.back().continues).push_back(jump);
+			break;
+		}
+		default:
+		{
+			compile_node(statement);
+			chunk->emit(nesting == 0 ? OP_DUMP : OP_POP); // Same as the tree walker, top level statements print their result
+			pop();
+			break;
+		}
+	}
+}
+
+std::unique_ptr<chunk_t> compiler_t::compile(const program_t& program)
+{
+	chunk = std::make_unique<chunk_t>();
+	chunk->names = program.globals; // resolver_t already gave every variable its slot
+	depth = 0;
+	nesting = 0;
+	in_function = false;
+	loops.clear();
+
+	for (const ast_ptr_t<stmt_t>& statement : program.statements)
+		compile_statement(*statement);
+
+	chunk->emit(OP_RETURN);
+
+	return std::move(chunk);
+}
+
+// Locals aren't counted in max_stack, the VM makes room for them (script_function_t::locals) on every call.
+std::unique_ptr<chunk_t> compiler_t::compile(const script_function_t& function)
+{
+	chunk = std::make_unique<chunk_t>();
+	chunk->names = function.globals;
+	depth = 0;
+	nesting = 1;
+	in_function = true;
+	loops.clear();
+
+	for (const ast_ptr_t<stmt_t>& statement : function.body)
+		compile_statement(*statement);
+
+	chunk->emit(OP_VOID); // falling off the end returns void
+	push();
+	chunk->emit(OP_RETURN);
+
+	return std::move(chunk);
+}
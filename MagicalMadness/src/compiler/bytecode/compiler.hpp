@@ -0,0 +1,57 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "../parser/parser.hpp"
+
+// Turns a parsed (and resolved, see resolver_t) program into a chunk_t for the VM. The tree is only read, never consumed.
+// Functions are compiled by their own compiler_t into their own chunk.
+class compiler_t
+{
+private:
+	// Jumps out of the loop being compiled, patched once the loop's end (or continue point) is known
+	struct loop_t
+	{
+		std::vector<std::size_t> breaks{};
+		std::vector<std::size_t> continues{};
+	};
+
+	std::unique_ptr<chunk_t> chunk;
+	std::size_t depth = 0;		// current operand stack depth, for chunk_t::max_stack
+	std::size_t nesting = 0;	// > 0 inside blocks and functions, only top level statements print their result
+	bool in_function = false;	// returning a call from a function is a tail call
+	std::vector<loop_t> loops{};
+
+	void push(std::size_t count = 1);
+	void pop(std::size_t count = 1);
+
+	std::size_t emit_jump(opcode_t op);				// returns the operand to patch
+	void patch_jump(std::size_t operand);			// makes it jump to the end of the code
+	void patch_jumps(std::vector<std::size_t>& operands);
+	void emit_loop(opcode_t op, std::size_t target);
+	void emit_store(const identifier_expr_t& identifier);
+
+	// Expressions, each leaves exactly one value on the stack
+	void compile_primary(const primary_expr_t& primary);
+	void compile_binary(const binary_expr_t& binary);
+	void compile_logical(const logical_expr_t& logical);
+	void compile_call(const call_stmt_t& call, opcode_t op = OP_CALL);
+	void compile_assignment(const assignment_stmt_t& assignment);
+	void compile_node(const stmt_t& node);
+
+	// Statements, these leave the stack as it was
+	void compile_body(const stmt_t& body);
+	void compile_if(const if_stmt_t& root);
+	void compile_while(const while_stmt_t& loop);
+	void compile_for(const for_stmt_t& loop);
+	void compile_function(const function_stmt_t& declaration);
+	void compile_return(const return_stmt_t& return_statement);
+	void compile_statement(const stmt_t& statement);
+public:
+	compiler_t() = default;
+	compiler_t(const compiler_t&) = delete;
+
+	std::unique_ptr<chunk_t> compile(const program_t& program);
+	std::unique_ptr<chunk_t> compile(const script_function_t& function);
+};
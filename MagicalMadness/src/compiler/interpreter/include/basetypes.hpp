@@ -2,117 +2,393 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
 
 #include "../../parser/parser.hpp"
 
 
-#define cast_stmt(_ty, val) std::make_unique<_ty>(std::move(dynamic_cast<_ty&>(*val)))
-
-
 enum runtime_type
 {
 	RUNTIME_VOID,
 	RUNTIME_NUMBER,
+	RUNTIME_INTEGER,
 	RUNTIME_STRING,
 	RUNTIME_IDENTIFIER,
-	RUNTIME_FUNCTION
+	RUNTIME_FUNCTION,
+	RUNTIME_ARRAY
 };
 
 const std::string type_strings[] = {
 	"void",
 	"number",
+	"integer",
 	"string",
 	"identifier",
-	"function"
+	"function",
+	"array"
 };
 
-using native_function_t = std::int32_t(*)();
+class value_t;
+class script_profile_t;
 
-class runtime_value_t
+// Natives get a pointer to their arguments (already checked to be exactly arity of them), see native.hpp for binding normal C++ functions.
+using native_function_t = value_t(*)(const value_t* arguments);
+
+// Anything that has to live on the heap (strings, functions & arrays). Owned by every value_t pointing at it.
+class runtime_object_t
 {
 public:
-	runtime_value_t(runtime_type type) : type{ type } {};
-	virtual ~runtime_value_t() = default;
+	runtime_object_t(runtime_type type) : type{ type } {};
+	virtual ~runtime_object_t() = default;
 
 	runtime_type type = RUNTIME_VOID;
+	std::atomic<std::uint32_t> references = 0; // atomic since compiled constants can be shared between threads
 
-	virtual void dump()
-	{
-		std::printf("%s | NULL\n", type_strings[type].c_str());
-	}
+	virtual void dump() const = 0;
 };
 
-class runtime_number_t : public runtime_value_t
+// Immutable text. Concatenating long strings doesn't copy them, the result only points at both halves (a rope) and is copied into one
+// string the first time its text is needed. A report built one line at a time is copied once in the end instead of on every line.
+// Short strings are a plain std::string, its small string buffer keeps them in the object itself.
+class runtime_string_t : public runtime_object_t
 {
-public:
-	runtime_number_t(float value) : value{ value }, runtime_value_t{ RUNTIME_NUMBER } {};
+private:
+	mutable std::string value;
+	mutable runtime_string_t* left = nullptr;	// halves of a concatenation, both null once it's flat
+	mutable runtime_string_t* right = nullptr;
+	mutable std::atomic<bool> flat = true;
+	std::size_t length = 0;
 
-	float value = 0;
+	static inline std::mutex flatten_mutex{}; // strings are shared between threads (parallel_map), only one flattens at a time
 
-	void dump() override
+	void flatten() const
 	{
-		std::printf("%s | %.02f\n", type_strings[type].c_str(), value);
+		std::lock_guard lock{ flatten_mutex };
+		if (flat.load(std::memory_order_relaxed))
+			return;
+
+		std::string result{};
+		result.reserve(length);
+
+		// Left to right without recursing, a string built one line at a time is as deep as it has lines
+		std::vector<const runtime_string_t*> pending{ right, left };
+		while (!pending.empty())
+		{
+			const runtime_string_t* part = pending.back();
+			pending.pop_back();
+
+			if (part->flat.load(std::memory_order_relaxed))
+				result += part->value;
+			else
+			{
+				pending.push_back(part->right);
+				pending.push_back(part->left);
+			}
+		}
+
+		value = std::move(result);
+		release(left);
+		release(right);
+		left = right = nullptr;
+		flat.store(true, std::memory_order_release);
 	}
-};
 
-class runtime_string_t : public runtime_value_t
-{
+	// Same reason, deleting a rope whose destructor releases its halves would recurse as deep as the rope
+	static void release(runtime_string_t* string)
+	{
+		std::vector<runtime_string_t*> pending{};
+		while (string)
+		{
+			runtime_string_t* next = nullptr;
+			if (--string->references == 0)
+			{
+				if (string->right)
+					pending.push_back(string->right);
+
+				next = string->left;
+				string->left = string->right = nullptr;
+				delete string;
+			}
+
+			if (!next && !pending.empty())
+			{
+				next = pending.back();
+				pending.pop_back();
+			}
+			string = next;
+		}
+	}
 public:
-	runtime_string_t(const std::string& value) : value{ value }, runtime_value_t{RUNTIME_STRING} {};
+	// Up to this long a concatenation is copied right away, a rope node costs more than copying a few bytes
+	static constexpr std::size_t min_rope_length = 64;
+
+	runtime_string_t(std::string value) : value{ std::move(value) }, runtime_object_t{ RUNTIME_STRING }
+	{
+		this->length = this->value.size();
+	}
+
+	// left + right
+	runtime_string_t(runtime_string_t& left, runtime_string_t& right) : left{ &left }, right{ &right }, flat{ false }, length{ left.length + right.length }, runtime_object_t{ RUNTIME_STRING }
+	{
+		++left.references;
+		++right.references;
+	}
+
+	~runtime_string_t() override
+	{
+		release(left);
+		release(right);
+	}
+
+	std::size_t size() const
+	{
+		return length;
+	}
 
-	std::string value;
+	const std::string& text() const
+	{
+		if (!flat.load(std::memory_order_acquire))
+			flatten();
+
+		return value;
+	}
 
-	void dump() override
+	void dump() const override
 	{
-		std::printf("%s | \"%s\"\n", type_strings[type].c_str(), value.c_str());
+		std::printf("%s | \"%s\"\n", type_strings[type].c_str(), text().c_str());
 	}
 };
 
-class runtime_identifier_t : public runtime_value_t
+class runtime_identifier_t : public runtime_object_t
 {
 public:
-	runtime_identifier_t(const std::string& name) : name{ name }, runtime_value_t{RUNTIME_IDENTIFIER} {};
+	runtime_identifier_t(const std::string& name) : name{ name }, runtime_object_t{ RUNTIME_IDENTIFIER } {};
 
 	std::string name;
 
-	void dump() override
+	void dump() const override
 	{
 		std::printf("%s | \"%s\"", type_strings[type].c_str(), name.c_str());
 	}
 };
 
-class runtime_function_t : public runtime_value_t
+class runtime_function_t : public runtime_object_t
 {
 public:
-	runtime_function_t(const std::string& debug_name, native_function_t function ) : is_native{ true }, function{ function }, debug_name { debug_name }, runtime_value_t{ RUNTIME_FUNCTION } {};
-	runtime_function_t(native_function_t function) : is_native{ true }, function{ function }, runtime_value_t{ RUNTIME_FUNCTION } {};
-	runtime_function_t(const std::string& debug_name, std::unique_ptr<stmt_t> body) : is_native{ false }, body{ std::move(body) }, debug_name{ debug_name }, runtime_value_t{ RUNTIME_FUNCTION } {};
-	runtime_function_t(std::unique_ptr<stmt_t> body) : is_native{ false }, body{ std::move(body) }, runtime_value_t{ RUNTIME_FUNCTION } {};
+	runtime_function_t(const std::string& debug_name, native_function_t function, std::uint8_t arity) : is_native{ true }, function{ function }, arity{ arity }, debug_name { debug_name }, runtime_object_t{ RUNTIME_FUNCTION } {};
+	runtime_function_t(native_function_t function, std::uint8_t arity) : is_native{ true }, function{ function }, arity{ arity }, runtime_object_t{ RUNTIME_FUNCTION } {};
+	runtime_function_t(std::shared_ptr<const script_function_t> declaration, std::vector<std::uint32_t> global_slots) : is_native{ false }, arity{ static_cast<std::uint8_t>(declaration->parameters.size()) }, debug_name{ declaration->name }, global_slots{ std::move(global_slots) }, declaration{ std::move(declaration) }, runtime_object_t{ RUNTIME_FUNCTION } {};
 
 	std::string debug_name{ "anonymous function" };
 	bool is_native = false;
 
-	std::unique_ptr<stmt_t> body{};							// Native function
 	native_function_t function = nullptr;					// C++ function
+	std::uint8_t arity = 0;									// Arguments the function takes
+
+	std::shared_ptr<const script_function_t> declaration{};	// Script function, its tree and chunk
+	std::vector<std::uint32_t> global_slots{};				// Its globals linked to the environment it was declared in (see interpreter::make_function)
 
-	void dump() override
+	void dump() const override
 	{
 		std::printf("%s | %s | native?=%s\n", type_strings[type].c_str(), debug_name.c_str(), is_native ? "true" : "false");
 	}
 };
 
+enum array_type_t : std::uint8_t
+{
+	ARRAY_U8,
+	ARRAY_U32,
+	ARRAY_U64,
+	ARRAY_F64
+};
+
+const std::string array_type_strings[] = {
+	"u8",
+	"u32",
+	"u64",
+	"f64"
+};
+
+constexpr std::size_t array_element_sizes[] = { 1, 4, 8, 8 };
+
+// Fixed size array of one number type, so scripts can work on whole byte ranges at once (see scripting/script_arrays.hpp).
+// It owns its elements, or is a read only view of memory that outlives every script variable (the mapped image) and never copies it.
+// Slices share the elements of the array they're from. Arrays can be written, parallel_map workers writing different elements of one is fine.
+class runtime_array_t : public runtime_object_t
+{
+public:
+	runtime_array_t(array_type_t element, std::size_t count) : element{ element }, count{ count }, storage{ new std::uint8_t[count * array_element_sizes[element]]() }, runtime_object_t{ RUNTIME_ARRAY }
+	{
+		this->data = this->writable = this->storage.get();
+	}
+
+	runtime_array_t(array_type_t element, const std::uint8_t* data, std::size_t count) : element{ element }, count{ count }, data{ data }, runtime_object_t{ RUNTIME_ARRAY } {};
+
+	runtime_array_t(const runtime_array_t& array, std::size_t first, std::size_t count) : element{ array.element }, count{ count }, storage{ array.storage }, runtime_object_t{ RUNTIME_ARRAY }
+	{
+		this->data = array.data + first * array.element_size();
+		if (array.writable)
+			this->writable = array.writable + first * array.element_size();
+	}
+
+	array_type_t element = ARRAY_U8;
+	std::size_t count = 0;
+	const std::uint8_t* data = nullptr;
+	std::uint8_t* writable = nullptr;				// null for views
+	std::shared_ptr<std::uint8_t[]> storage{};		// null for views
+
+	std::size_t element_size() const
+	{
+		return array_element_sizes[element];
+	}
+
+	std::size_t bytes() const
+	{
+		return count * element_size();
+	}
+
+	void dump() const override
+	{
+		std::printf("%s | %s[%zu] {", type_strings[type].c_str(), array_type_strings[element].c_str(), count);
+		for (std::size_t i = 0; i < count && i < 16; ++i)
+		{
+			const std::uint8_t* at = data + i * element_size();
+			std::uint64_t integer = 0;
+			double number = 0.0;
+
+			if (element == ARRAY_F64)
+			{
+				std::memcpy(&number, at, sizeof(number));
+				std::printf(" %g", number);
+			}
+			else
+			{
+				std::memcpy(&integer, at, element_size()); // little endian
+				std::printf(" 0x%llX", static_cast<unsigned long long>(integer));
+			}
+		}
+		std::printf(count > 16 ? " ... }\n" : " }\n");
+	}
+};
+
+// Every value the runtime passes around. Small enough to copy freely; numbers & integers are stored inline so arithmetic never allocates,
+// only strings, functions and arrays point to a (reference counted) runtime_object_t.
+class value_t
+{
+private:
+	void retain() const
+	{
+		if (is_object())
+			++object->references;
+	}
+
+	void release()
+	{
+		if (is_object() && --object->references == 0)
+			delete object;
+	}
+public:
+	runtime_type type = RUNTIME_VOID;
+	union
+	{
+		float number;
+		std::int64_t integer;		// Widest member, copying it copies whichever one is active (on x86 and x64)
+		runtime_object_t* object;
+	};
+
+	value_t() : integer{ 0 } {};
+	value_t(float number) : type{ RUNTIME_NUMBER }, number{ number } {};
+	value_t(std::int64_t integer) : type{ RUNTIME_INTEGER }, integer{ integer } {};
+	explicit value_t(runtime_object_t* object) : type{ object->type }, object{ object }
+	{
+		retain();
+	}
+
+	value_t(const value_t& other) : type{ other.type }, integer{ other.integer }
+	{
+		retain();
+	}
+
+	value_t(value_t&& other) noexcept : type{ other.type }, integer{ other.integer }
+	{
+		other.type = RUNTIME_VOID;
+	}
+
+	value_t& operator=(value_t other) noexcept
+	{
+		std::swap(type, other.type);
+		std::swap(integer, other.integer);
+		return *this;
+	}
+
+	~value_t()
+	{
+		release();
+	}
+
+	// value_t::make<runtime_string_t>("text")
+	template <typename object_type, typename... arguments_t>
+	static value_t make(arguments_t&&... arguments)
+	{
+		return value_t{ new object_type(std::forward<arguments_t>(arguments)...) };
+	}
+
+	bool is_object() const
+	{
+		return type >= RUNTIME_STRING;
+	}
+
+	runtime_string_t& as_string() const
+	{
+		return static_cast<runtime_string_t&>(*object);
+	}
+
+	runtime_function_t& as_function() const
+	{
+		return static_cast<runtime_function_t&>(*object);
+	}
+
+	runtime_array_t& as_array() const
+	{
+		return static_cast<runtime_array_t&>(*object);
+	}
+
+	void dump() const
+	{
+		switch (type)
+		{
+			case RUNTIME_VOID:
+				std::printf("%s | NULL\n", type_strings[type].c_str());
+				break;
+			case RUNTIME_NUMBER:
+				std::printf("%s | %.02f\n", type_strings[type].c_str(), number);
+				break;
+			case RUNTIME_INTEGER:
+				std::printf("%s | %lld (0x%llX)\n", type_strings[type].c_str(), static_cast<long long>(integer), static_cast<unsigned long long>(integer));
+				break;
+			default:
+				object->dump();
+				break;
+		}
+	}
+};
+
 
-// One scope, it falls back on previous scopes
+// One scope, it falls back on previous scopes.
+// Variables live in a flat array, the name map is only used to find a variable's slot. Compiled scripts look their slots up once per run (see run_bytecode).
 class environment_t
 {
 private:
 	// Helps to follow assign rules. "If it's in the current scope then override, else check parents, if nothing in parents then override this container."
-	bool assign_internal(const std::string& var_name, std::shared_ptr<runtime_value_t> value)
+	bool assign_internal(const std::string& var_name, const value_t& value)
 	{
-		auto found = variables.find(var_name);
-		if (found != variables.end())
+		auto found = slots.find(var_name);
+		if (found != slots.end())
 		{
-			found->second = value;
+			values[found->second] = value;
 			return true;
 		}
 		else if (parent)
@@ -124,46 +400,87 @@ public:
 	environment_t() = default;
 	environment_t(std::unique_ptr<environment_t> parent) : parent{ std::move(parent)} {};
 
-	void assign(const std::string& var_name, std::shared_ptr<runtime_value_t> value)
+	// Every variable copied with the same slots, so functions linked to this one work in the copy too.
+	// The copy can be changed on another thread while this one is only read (strings & functions are shared, they never change, arrays are shared too).
+	std::unique_ptr<environment_t> copy() const
+	{
+		std::unique_ptr<environment_t> output = std::make_unique<environment_t>(parent ? parent->copy() : nullptr);
+		output->slots = slots;
+		output->values = values;
+		return output;
+	}
+
+	// Slot of a variable in this scope, made (holding void) if it doesn't exist yet.
+	std::uint32_t slot(const std::string& var_name)
 	{
-		auto found = variables.find(var_name);
-		if (found != variables.end())
-			found->second = value;
+		auto [found, inserted] = slots.try_emplace(var_name, static_cast<std::uint32_t>(values.size()));
+		if (inserted)
+			values.emplace_back();
+
+		return found->second;
+	}
+
+	void assign(const std::string& var_name, value_t value)
+	{
+		auto found = slots.find(var_name);
+		if (found != slots.end())
+			values[found->second] = std::move(value);
 		else if (!assign_internal(var_name, value))
-			variables[var_name] = value;
+			values[slot(var_name)] = std::move(value);
 	}
-	std::shared_ptr<runtime_value_t> retrieve(const std::string& var_name)
+	value_t retrieve(const std::string& var_name)
 	{
-		auto found = variables.find(var_name);
-		if (found != variables.end())
-			return found->second;
+		auto found = slots.find(var_name);
+		if (found != slots.end())
+			return values[found->second];
 		else if (parent)
 			return parent->retrieve(var_name);
 
-		return std::make_unique<runtime_value_t>(RUNTIME_VOID);
+		return {};
 	}
 
-	std::unordered_map<std::string, std::shared_ptr<runtime_value_t>> variables{};
+	std::unordered_map<std::string, std::uint32_t> slots{};
+	std::vector<value_t> values{};
 	std::unique_ptr<environment_t> parent;
 };
 
 
+// Where a script function returns to, the VM pushes one for every call it makes.
+class call_frame_t
+{
+public:
+	const chunk_t* chunk = nullptr;
+	const std::uint8_t* ip = nullptr;
+	const std::uint32_t* global_slots = nullptr;
+	std::size_t base = 0; // first local on the stack, the arguments are the first locals
+};
+
 // This holds the context for all execution, current call stack, etc. Anything execution this will be used in
 class execution_state_t
 {
 public:
-	std::vector<std::shared_ptr<runtime_value_t>> stack{};
-	std::shared_ptr<runtime_function_t> current_function;
+	std::vector<value_t> stack{};
+	std::vector<call_frame_t> frames{};
+	std::vector<std::uint32_t> global_slots{};	// chunk_t::names index -> slot in global_env, filled in when a chunk starts running
+	value_t current_function{};
 	std::shared_ptr<environment_t> global_env;
 
-	void push_stack(std::shared_ptr<runtime_value_t> value) // do I separate these or no?
+	// Limits for the VM, checked on backward jumps and calls (the only ways a script keeps running). Hitting one throws.
+	std::uint64_t max_instructions = 0;				// 0 = no limit
+	const std::atomic<bool>* cancelled = nullptr;	// set from another thread to stop the script
+	script_profile_t* profile = nullptr;			// filled in while running when set, see profile.hpp
+	std::uint64_t instructions = 0;					// executed by the last run, also when it threw
+
+	void push_stack(value_t value) // do I separate these or no?
 	{
-		stack.push_back(value);
+		stack.push_back(std::move(value));
 	}
 
-	std::shared_ptr<runtime_value_t> pop_stack()
+	value_t pop_stack()
 	{
+		value_t value = std::move(stack.back());
 		stack.pop_back();
+		return value;
 	}
 
 	std::size_t stack_size()
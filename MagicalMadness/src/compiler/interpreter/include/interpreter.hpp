@@ -4,5 +4,6 @@
 
 namespace interpreter
 {
-	std::shared_ptr<runtime_value_t> run_tree(std::unique_ptr<stmt_t> current, std::shared_ptr<environment_t> environment);
+	// Only reads the tree, the same program can be run as many times as needed.
+	value_t run_tree(const stmt_t& current, environment_t& environment);
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "../include/basetypes.hpp"
+
+// Exposes plain C++ functions to scripts. The unpacking of arguments and packing of the result is generated at compile time,
+// calling one only converts the values already on the VM stack, nothing is allocated (unless it returns a string).
+//
+//	std::uint32_t read_u32(std::uint32_t address);
+//	environment->assign("read_u32", bind_native<&read_u32>("read_u32"));
+namespace native
+{
+	[[noreturn]] inline void argument_error(std::size_t index, const char* expected, const value_t& value)
+	{
+		throw std::runtime_error("Bad argument #" + std::to_string(index + 1) + ": expected " + expected + ", got " + type_strings[value.type]);
+	}
+
+	// value_t -> C++, one specialization per kind of parameter
+	template <typename type, typename = void>
+	struct argument_t
+	{
+		static_assert(sizeof(type) == 0, "This parameter type can't be passed from scripts");
+	};
+
+	template <typename type>
+	struct argument_t<type, std::enable_if_t<std::is_integral_v<type>>>
+	{
+		static type get(const value_t& value, std::size_t index)
+		{
+			if (value.type == RUNTIME_INTEGER)
+				return static_cast<type>(value.integer);
+			if (value.type == RUNTIME_NUMBER)
+				return static_cast<type>(value.number);
+
+			argument_error(index, "integer", value);
+		}
+	};
+
+	template <typename type>
+	struct argument_t<type, std::enable_if_t<std::is_floating_point_v<type>>>
+	{
+		static type get(const value_t& value, std::size_t index)
+		{
+			if (value.type == RUNTIME_NUMBER)
+				return static_cast<type>(value.number);
+			if (value.type == RUNTIME_INTEGER)
+				return static_cast<type>(value.integer);
+
+			argument_error(index, "number", value);
+		}
+	};
+
+	// Strings are passed by reference/view straight out of the runtime string, no copy.
+	template <>
+	struct argument_t<std::string>
+	{
+		static const std::string& get(const value_t& value, std::size_t index)
+		{
+			if (value.type != RUNTIME_STRING)
+				argument_error(index, "string", value);
+
+			return value.as_string().text();
+		}
+	};
+
+	template <>
+	struct argument_t<std::string_view>
+	{
+		static std::string_view get(const value_t& value, std::size_t index)
+		{
+			return argument_t<std::string>::get(value, index);
+		}
+	};
+
+	template <>
+	struct argument_t<runtime_array_t>
+	{
+		static const runtime_array_t& get(const value_t& value, std::size_t index)
+		{
+			if (value.type != RUNTIME_ARRAY)
+				argument_error(index, "array", value);
+
+			return value.as_array();
+		}
+	};
+
+	template <>
+	struct argument_t<value_t>
+	{
+		static const value_t& get(const value_t& value, std::size_t)
+		{
+			return value;
+		}
+	};
+
+	// C++ -> value_t
+	template <typename type>
+	value_t to_value(type&& result)
+	{
+		using plain_t = std::remove_cvref_t<type>;
+
+		if constexpr (std::is_same_v<plain_t, value_t>)
+			return std::forward<type>(result);
+		else if constexpr (std::is_integral_v<plain_t>)
+			return static_cast<std::int64_t>(result);
+		else if constexpr (std::is_floating_point_v<plain_t>)
+			return static_cast<float>(result);
+		else if constexpr (std::is_convertible_v<type, std::string>)
+			return value_t::make<runtime_string_t>(std::string{ std::forward<type>(result) });
+		else
+			static_assert(sizeof(plain_t) == 0, "This return type can't be passed to scripts");
+	}
+
+	template <typename>
+	struct function_traits_t;
+
+	template <typename result_type, typename... parameter_types>
+	struct function_traits_t<result_type(*)(parameter_types...)>
+	{
+		using result_t = result_type;
+		using parameters_t = std::tuple<std::remove_cvref_t<parameter_types>...>;
+		static constexpr std::size_t arity = sizeof...(parameter_types);
+	};
+
+	template <typename result_type, typename... parameter_types>
+	struct function_traits_t<result_type(*)(parameter_types...) noexcept> : function_traits_t<result_type(*)(parameter_types...)> {};
+
+	template <auto function, std::size_t... indices>
+	value_t invoke(const value_t* arguments, std::index_sequence<indices...>)
+	{
+		using traits = function_traits_t<decltype(function)>;
+
+		if constexpr (std::is_void_v<typename traits::result_t>)
+		{
+			function(argument_t<std::tuple_element_t<indices, typename traits::parameters_t>>::get(arguments[indices], indices)...);
+			return {};
+		}
+		else
+			return to_value(function(argument_t<std::tuple_element_t<indices, typename traits::parameters_t>>::get(arguments[indices], indices)...));
+	}
+
+	// The native_function_t every bound function ends up as.
+	template <auto function>
+	value_t thunk(const value_t* arguments)
+	{
+		return invoke<function>(arguments, std::make_index_sequence<function_traits_t<decltype(function)>::arity>{});
+	}
+}
+
+template <auto function>
+value_t bind_native(const std::string& name)
+{
+	constexpr std::size_t arity = native::function_traits_t<decltype(function)>::arity;
+	static_assert(arity <= UINT8_MAX, "Too many parameters for a script function");
+
+	return value_t::make<runtime_function_t>(name, &native::thunk<function>, static_cast<std::uint8_t>(arity));
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "../include/basetypes.hpp"
+
+// Operators on runtime values, shared by the tree walker and the VM so both give the same results (and errors).
+namespace interpreter
+{
+	[[noreturn]] inline void operand_error(binary_operator_t operand, const value_t& left, const value_t& right)
+	{
+		std::string err = "attempt to " + binary_operator_strings[operand] + " " + type_strings[left.type] + " and " + type_strings[right.type];
+		throw std::runtime_error(err);
+	}
+
+	inline float to_float(const value_t& value)
+	{
+		return value.type == RUNTIME_INTEGER ? static_cast<float>(value.integer) : value.number;
+	}
+
+	// Deepest script functions can call each other. The tree walker recurses on the C++ stack, this keeps it far from the end of it.
+	constexpr std::size_t max_call_depth = 200;
+
+	// Same for the VM, its calls are frames on the heap so only memory limits them. Tail calls don't count, they reuse the frame.
+	constexpr std::size_t max_vm_call_depth = 1000000;
+
+	// void, 0 and 0.0 are false, everything else is true (strings and functions too)
+	inline bool is_truthy(const value_t& value)
+	{
+		switch (value.type)
+		{
+			case RUNTIME_VOID:
+				return false;
+			case RUNTIME_NUMBER:
+				return value.number != 0.f;
+			case RUNTIME_INTEGER:
+				return value.integer != 0;
+			default:
+				return true;
+		}
+	}
+
+	template <typename type>
+	inline value_t compare(binary_operator_t operand, const type& a, const type& b)
+	{
+		switch (operand)
+		{
+			case BINARY_EQUAL:
+				return static_cast<std::int64_t>(a == b);
+			case BINARY_NOT_EQUAL:
+				return static_cast<std::int64_t>(a != b);
+			case BINARY_LESS:
+				return static_cast<std::int64_t>(a < b);
+			case BINARY_LESS_EQUAL:
+				return static_cast<std::int64_t>(a <= b);
+			case BINARY_GREATER:
+				return static_cast<std::int64_t>(a > b);
+			case BINARY_GREATER_EQUAL:
+				return static_cast<std::int64_t>(a >= b);
+			default:
+				throw std::runtime_error("Unknown comparison: \"" + binary_operator_strings[operand] + "\"");
+		}
+	}
+
+	// Wraps around like the CPU would, the math is done unsigned so overflowing is defined.
+	inline value_t integer_arithmetic(binary_operator_t operand, std::int64_t left, std::int64_t right)
+	{
+		std::uint64_t a = static_cast<std::uint64_t>(left);
+		std::uint64_t b = static_cast<std::uint64_t>(right);
+
+		switch (operand)
+		{
+			case BINARY_ADD:
+				return static_cast<std::int64_t>(a + b);
+			case BINARY_SUBTRACT:
+				return static_cast<std::int64_t>(a - b);
+			case BINARY_MULTIPLY:
+				return static_cast<std::int64_t>(a * b);
+			case BINARY_DIVIDE:
+			case BINARY_MODULO:
+			{
+				if (right == 0)
+					throw std::runtime_error("attempt to " + binary_operator_strings[operand] + " by zero");
+
+				if (right == -1) // INT64_MIN / -1 traps on x86
+					return operand == BINARY_DIVIDE ? static_cast<std::int64_t>(0 - a) : std::int64_t{ 0 };
+
+				return operand == BINARY_DIVIDE ? left / right : left % right;
+			}
+			case BINARY_POWER:
+			{
+				if (right < 0)
+					return powf(static_cast<float>(left), static_cast<float>(right));
+
+				std::uint64_t result = 1;
+				for (; b; b >>= 1, a *= a)
+				{
+					if (b & 1)
+						result *= a;
+				}
+				return static_cast<std::int64_t>(result);
+			}
+			case BINARY_AND:
+				return static_cast<std::int64_t>(a & b);
+			case BINARY_OR:
+				return static_cast<std::int64_t>(a | b);
+			case BINARY_XOR:
+				return static_cast<std::int64_t>(a ^ b);
+			case BINARY_SHIFT_LEFT:
+				return static_cast<std::int64_t>(a << (b & 63));
+			case BINARY_SHIFT_RIGHT:
+				return static_cast<std::int64_t>(a >> (b & 63)); // logical, addresses aren't signed
+			case BINARY_EQUAL:
+			case BINARY_NOT_EQUAL:
+			case BINARY_LESS:
+			case BINARY_LESS_EQUAL:
+			case BINARY_GREATER:
+			case BINARY_GREATER_EQUAL:
+				return compare(operand, left, right);
+			default:
+				throw std::runtime_error("Unknown binary operation: \"" + binary_operator_strings[operand] + "\"");
+		}
+	}
+
+	// string + string, see runtime_string_t for why long ones aren't copied
+	inline value_t concatenate(const value_t& left, const value_t& right)
+	{
+		runtime_string_t& a = left.as_string();
+		runtime_string_t& b = right.as_string();
+
+		if (b.size() == 0)
+			return left;
+		if (a.size() == 0)
+			return right;
+		if (a.size() + b.size() <= runtime_string_t::min_rope_length)
+			return value_t::make<runtime_string_t>(a.text() + b.text());
+
+		return value_t::make<runtime_string_t>(a, b);
+	}
+
+	inline value_t arithmetic(binary_operator_t operand, const value_t& left, const value_t& right)
+	{
+		if (left.type == RUNTIME_INTEGER && right.type == RUNTIME_INTEGER) // Most address math never leaves this
+			return integer_arithmetic(operand, left.integer, right.integer);
+
+		bool numeric = (left.type == RUNTIME_NUMBER || left.type == RUNTIME_INTEGER) && (right.type == RUNTIME_NUMBER || right.type == RUNTIME_INTEGER);
+		if (operand >= BINARY_EQUAL)
+		{
+			if (numeric)
+				return compare(operand, to_float(left), to_float(right));
+			if (left.type == RUNTIME_STRING && right.type == RUNTIME_STRING)
+				return compare(operand, left.as_string().text(), right.as_string().text());
+
+			// Anything can be checked for equality, different types are never equal and objects are only equal to themselves
+			bool equal = left.type == right.type && (left.type == RUNTIME_VOID || left.object == right.object);
+			if (operand == BINARY_EQUAL)
+				return static_cast<std::int64_t>(equal);
+			if (operand == BINARY_NOT_EQUAL)
+				return static_cast<std::int64_t>(!equal);
+
+			operand_error(operand, left, right);
+		}
+
+		if (operand == BINARY_ADD && left.type == RUNTIME_STRING && right.type == RUNTIME_STRING)
+			return concatenate(left, right);
+
+		if (!numeric || operand >= BINARY_AND) // bitwise operators only take integers
+			operand_error(operand, left, right);
+
+		float a = to_float(left);
+		float b = to_float(right);
+
+		switch (operand)
+		{
+			case BINARY_ADD:
+				return a + b;
+			case BINARY_SUBTRACT:
+				return a - b;
+			case BINARY_MULTIPLY:
+				return a * b;
+			case BINARY_DIVIDE:
+				return a / b;
+			case BINARY_MODULO:
+			{
+				if (static_cast<int>(b) == 0)
+					throw std::runtime_error("attempt to % by zero");
+
+				return static_cast<float>(static_cast<int>(a) % static_cast<int>(b));
+			}
+			case BINARY_POWER:
+				return powf(a, b);
+			default:
+				throw std::runtime_error("Unknown binary operation: \"" + binary_operator_strings[operand] + "\"");
+		}
+	}
+
+	// Declaring a function makes a value of it, its globals are linked to the environment here once instead of on every call.
+	inline value_t make_function(const std::shared_ptr<const script_function_t>& declaration, environment_t& environment)
+	{
+		std::vector<std::uint32_t> global_slots(declaration->globals.size());
+		for (std::size_t i = 0; i < global_slots.size(); ++i)
+			global_slots[i] = environment.slot(declaration->globals[i]);
+
+		return value_t::make<runtime_function_t>(declaration, std::move(global_slots));
+	}
+
+	inline void check_arguments(const runtime_function_t& function, std::size_t count)
+	{
+		if (count != function.arity)
+			throw std::runtime_error(function.debug_name + " takes " + std::to_string(function.arity) + " argument(s), got " + std::to_string(count));
+	}
+
+	inline value_t logical_not(const value_t& value)
+	{
+		if (value.type == RUNTIME_INTEGER)
+			return static_cast<std::int64_t>(!value.integer);
+		if (value.type != RUNTIME_NUMBER)
+			return {};
+
+		return static_cast<float>(!value.number);
+	}
+
+	inline value_t negate(const value_t& value)
+	{
+		if (value.type == RUNTIME_INTEGER)
+			return static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(value.integer));
+		if (value.type != RUNTIME_NUMBER)
+			return {};
+
+		return -value.number;
+	}
+
+	inline value_t complement(const value_t& value)
+	{
+		if (value.type != RUNTIME_INTEGER)
+			return {};
+
+		return ~value.integer;
+	}
+}
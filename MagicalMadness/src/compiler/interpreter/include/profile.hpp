@@ -0,0 +1,44 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../bytecode/bytecode.hpp"
+
+// What one function did during a profiled run. Time includes the functions it called, instructions are only its own.
+struct function_profile_t
+{
+	std::string name{};
+	std::uint64_t calls = 0;
+	std::uint64_t compiled_calls = 0;	// finished as machine code (see jit.hpp), each loop iteration there counts as one instruction
+	std::uint64_t instructions = 0;
+	double milliseconds = 0.0;
+};
+
+// Filled in by the VM while execution_state_t::profile points at it. Costs a branch per instruction and a clock read per call, so it's off by default.
+class script_profile_t
+{
+public:
+	std::array<std::uint64_t, OP_RETURN + 1> opcodes{};				// how often each opcode ran
+	std::unordered_map<const void*, function_profile_t> functions{};	// keyed by chunk (natives by their function), the script itself is "<script>"
+
+	std::vector<const function_profile_t*> sorted() const // slowest first
+	{
+		std::vector<const function_profile_t*> output{};
+		output.reserve(functions.size());
+		for (const auto& [key, function] : functions)
+			output.push_back(&function);
+
+		std::sort(output.begin(), output.end(), [](const function_profile_t* a, const function_profile_t* b) { return a->milliseconds > b->milliseconds; });
+		return output;
+	}
+
+	void clear()
+	{
+		opcodes.fill(0);
+		functions.clear();
+	}
+};
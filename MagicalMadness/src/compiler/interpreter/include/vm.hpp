@@ -0,0 +1,12 @@
+#pragma once
+#include "../include/basetypes.hpp"
+#include "../../bytecode/bytecode.hpp"
+
+namespace interpreter
+{
+	// Runs a compiled chunk, state.stack is the operand stack (and holds the locals of running functions) and state.global_env holds the variables.
+	value_t run_bytecode(const chunk_t& program, execution_state_t& state);
+
+	// Calls a function value from C++ (natives that take a callback). Uses state like run_bytecode does, so it can't be one that's running.
+	value_t call_function(const value_t& function, const value_t* arguments, std::size_t count, execution_state_t& state);
+}
@@ -1,201 +1,393 @@
+#include <stdexcept>
+
 #include "../include/basetypes.hpp"
 #include "../include/interpreter.hpp"
+#include "../include/operations.hpp"
 
 using namespace interpreter;
 
-std::shared_ptr<runtime_value_t> eval_primary(primary_types_t type, std::unique_ptr<stmt_t> current, std::shared_ptr<environment_t> environment)
+// How the last statement finished. Anything but normal unwinds until something takes it (loops take break & continue, calls take return).
+enum completion_t
+{
+	COMPLETION_NORMAL,
+	COMPLETION_BREAK,
+	COMPLETION_CONTINUE,
+	COMPLETION_RETURN
+};
+
+// One call of the tree walker. Everything is found by the slot resolver_t gave it: globals through global_slots into the environment (linked once,
+// same as the VM), a function's locals on the stack shared by every call of the run.
+struct frame_t
+{
+	environment_t& environment;
+	std::vector<value_t>& stack;
+	const std::uint32_t* global_slots = nullptr;
+	std::size_t base = 0; // first local on the stack, the arguments are the first locals
+	std::size_t call_depth = 0;
+
+	completion_t completion = COMPLETION_NORMAL;
+	value_t result{}; // what return gave back
+};
+
+value_t evaluate(const stmt_t& current, frame_t& frame);
+void exec_statement(const stmt_t& statement, frame_t& frame, bool top_level);
+
+value_t eval_primary(const primary_expr_t& current, frame_t& frame)
 {
-	switch (type)
+	switch (current.type)
 	{
 		case PRIMARY_NUMBER:
 		{
-			std::unique_ptr<number_expr_t> number_expr = cast_stmt(number_expr_t, current);
-			return std::make_shared<runtime_number_t>(number_expr->value);
+			const number_expr_t& number_expr = static_cast<const number_expr_t&>(current);
+			return number_expr.value;
+		}
+		case PRIMARY_INTEGER:
+		{
+			const integer_expr_t& integer_expr = static_cast<const integer_expr_t&>(current);
+			return integer_expr.value;
 		}
 		case PRIMARY_STRING:
 		{
-			std::unique_ptr<string_expr_t> string_expr = cast_stmt(string_expr_t, current);
-			return std::make_shared<runtime_string_t>(string_expr->value);
+			const string_expr_t& string_expr = static_cast<const string_expr_t&>(current);
+			return value_t::make<runtime_string_t>(string_expr.value);
 		}
 		case PRIMARY_IDENTIFIER: // todo: do I grab value from env here? is identifier a primary?
 		{
-			std::unique_ptr<identifier_expr_t> identifier_expr = cast_stmt(identifier_expr_t, current);
-			return environment->retrieve(identifier_expr->variable_name);
+			const identifier_expr_t& identifier_expr = static_cast<const identifier_expr_t&>(current);
+			if (identifier_expr.depth != 0)
+				return frame.stack[frame.base + identifier_expr.slot];
+
+			return frame.environment.values[frame.global_slots[identifier_expr.slot]];
 		}
 		default:
 		{
-			std::printf("Primary type %d not implemented yet!\n", current->type);
+			std::printf("Primary type %d not implemented yet!\n", current.type);
 			break;
 		}
 	}
 
-	return std::make_shared<runtime_value_t>(RUNTIME_VOID);
+	return {};
 }
 
-std::shared_ptr<runtime_value_t> eval_unary(std::unique_ptr<unary_expr_t> current, std::shared_ptr<environment_t> environment)
+value_t eval_unary(const unary_expr_t& current, frame_t& frame)
 {
-	std::shared_ptr<runtime_value_t> child = run_tree(std::move(current->child), environment);
+	return logical_not(evaluate(*current.child, frame));
+}
 
-	if (child->type != RUNTIME_NUMBER)
-		return std::make_shared<runtime_value_t>(RUNTIME_VOID);
-	else
-	{
-		std::shared_ptr<runtime_number_t> runtime_number = cast_stmt(runtime_number_t, child);
-		return std::make_shared<runtime_number_t>(!(runtime_number->value));
-	}
+value_t eval_negate(const negate_expr_t& current, frame_t& frame)
+{
+	return negate(evaluate(*current.child, frame));
 }
 
-std::shared_ptr<runtime_value_t> eval_negate(std::unique_ptr<negate_expr_t> current, std::shared_ptr<environment_t> environment)
+value_t eval_complement(const complement_expr_t& current, frame_t& frame)
 {
-	std::shared_ptr<runtime_value_t> child = run_tree(std::move(current->child), environment);
+	return complement(evaluate(*current.child, frame));
+}
 
-	if (child->type != RUNTIME_NUMBER)
-		return std::make_shared<runtime_value_t>(RUNTIME_VOID);
-	else
+value_t eval_binop(const binary_expr_t& current, frame_t& frame)
+{
+	if (current.left->type != EXPR_BINARY)
+	{
+		value_t left = evaluate(*current.left, frame);
+		value_t right = evaluate(*current.right, frame);
+
+		return arithmetic(current.operand, left, right);
+	}
+
+	// A chain (a + b + c ...) is run in a loop, the recursion would go as deep as it's long
+	std::vector<const stmt_t*> chain = left_chain<const stmt_t>(current);
+	value_t result = evaluate(*static_cast<const binary_expr_t*>(chain.front())->left, frame);
+	for (const stmt_t* node : chain)
 	{
-		std::shared_ptr<runtime_number_t> runtime_number = cast_stmt(runtime_number_t, child);
-		return std::make_shared<runtime_number_t>(-(runtime_number->value));
+		const binary_expr_t& link = static_cast<const binary_expr_t&>(*node);
+		value_t right = evaluate(*link.right, frame);
+		result = arithmetic(link.operand, result, right);
 	}
+
+	return result;
 }
 
-std::shared_ptr<runtime_value_t> eval_binop(std::unique_ptr<binary_expr_t> current, std::shared_ptr<environment_t> environment)
+value_t eval_logical(const logical_expr_t& current, frame_t& frame)
 {
-	std::shared_ptr<runtime_value_t> left = run_tree(std::move(current->left), environment);
-	std::shared_ptr<runtime_value_t> right = run_tree(std::move(current->right), environment);
-
-	if (left->type != RUNTIME_NUMBER || right->type != RUNTIME_NUMBER)
+	if (current.left->type != EXPR_LOGICAL)
 	{
-		std::string err = "attempt to ";
-		err += current->operand + " " + type_strings[left->type] + " and " + type_strings[right->type];
+		value_t left = evaluate(*current.left, frame);
+		if (is_truthy(left) != current.is_and) // false && ..., true || ...
+			return left;
 
-		throw std::exception(err.c_str());
+		return evaluate(*current.right, frame);
 	}
 
-	std::shared_ptr<runtime_number_t> n_left = cast_stmt(runtime_number_t, left);
-	std::shared_ptr<runtime_number_t> n_right = cast_stmt(runtime_number_t, right);
-
-	switch (current->operand)
+	std::vector<const stmt_t*> chain = left_chain<const stmt_t>(current);
+	value_t result = evaluate(*static_cast<const logical_expr_t*>(chain.front())->left, frame);
+	for (const stmt_t* node : chain)
 	{
-		case '+':
-			return std::make_shared<runtime_number_t>(n_left->value + n_right->value);
-		case '-':
-			return std::make_shared<runtime_number_t>(n_left->value - n_right->value);
-		case '*':
-			return std::make_shared<runtime_number_t>(n_left->value * n_right->value);
-		case '/':
-			return std::make_shared<runtime_number_t>(n_left->value / n_right->value);
-		case '%':
-			return std::make_shared<runtime_number_t>(static_cast<float>(static_cast<int>(n_left->value) % static_cast<int>(n_right->value)));
-		case '^':
-			return std::make_shared<runtime_number_t>(powf(n_left->value, n_right->value));
-		default:
-		{
-			std::printf("Unknown binary operation: \"%c\"\n", current->operand || ' ');
-		}
+		const logical_expr_t& link = static_cast<const logical_expr_t&>(*node);
+		if (is_truthy(result) == link.is_and) // false && ..., true || ... keep the left side
+			result = evaluate(*link.right, frame);
 	}
 
-	return std::make_shared<runtime_value_t>(RUNTIME_VOID);
+	return result;
+}
+
+void assign(const identifier_expr_t& identifier, const value_t& value, frame_t& frame)
+{
+	if (identifier.depth != 0)
+		frame.stack[frame.base + identifier.slot] = value;
+	else
+		frame.environment.values[frame.global_slots[identifier.slot]] = value;
 }
 
-std::shared_ptr<runtime_value_t> eval_assignment(std::unique_ptr<assignment_stmt_t> current, std::shared_ptr<environment_t> environment)
+value_t eval_assignment(const assignment_stmt_t& current, frame_t& frame)
 {
-	if (current->variable->type != EXPR_PRIMARY)
+	if (current.variable->type != EXPR_PRIMARY)
 	{
-		throw std::exception("Attempt to assign a value to something that isn't a primary!");
+		throw std::runtime_error("Attempt to assign a value to something that isn't a primary!");
 	}
 
-	std::unique_ptr<primary_expr_t> primary_value = cast_stmt(primary_expr_t, current->variable);
+	const primary_expr_t& primary_value = static_cast<const primary_expr_t&>(*current.variable);
 
-	std::shared_ptr<runtime_value_t> new_value = run_tree(std::move(current->assignment), environment);
+	value_t new_value = evaluate(*current.assignment, frame);
 
-	if (primary_value->type != PRIMARY_IDENTIFIER)
-		throw std::exception("Attempt to assign a value to something that isn't a variable!");
-	
-	std::unique_ptr<identifier_expr_t> identifier_expr = cast_stmt(identifier_expr_t, current->variable);
+	if (primary_value.type != PRIMARY_IDENTIFIER)
+		throw std::runtime_error("Attempt to assign a value to something that isn't a variable!");
 
-	environment->assign(identifier_expr->variable_name, new_value);
+	assign(static_cast<const identifier_expr_t&>(primary_value), new_value, frame);
 
 	return new_value;
 }
 
-std::shared_ptr<runtime_value_t> eval_call(std::unique_ptr<call_stmt_t> call_info, std::shared_ptr<environment_t> environment)
+void exec_block(const std::vector<ast_ptr_t<stmt_t>>& statements, frame_t& frame)
+{
+	for (const ast_ptr_t<stmt_t>& statement : statements)
+	{
+		exec_statement(*statement, frame, false);
+		if (frame.completion != COMPLETION_NORMAL)
+			return;
+	}
+}
+
+value_t eval_call(const call_stmt_t& call_info, frame_t& frame)
 {
-	std::shared_ptr<runtime_value_t> value = run_tree(std::move(call_info->function), environment);
+	value_t value = evaluate(*call_info.function, frame);
 
-	if (value->type != RUNTIME_FUNCTION)
-		throw std::exception("Attempt to call a value that isn't a function!");
+	if (value.type != RUNTIME_FUNCTION)
+		throw std::runtime_error("Attempt to call a value that isn't a function!");
 
-	std::shared_ptr<runtime_function_t> function = cast_stmt(runtime_function_t, value);
+	const runtime_function_t& function = value.as_function();
 
-	if (function->is_native)
+	check_arguments(function, call_info.arguments.size());
+
+	// Arguments go on the stack, for natives that's the array they read and for script functions they're the first locals.
+	// Evaluating one can run calls that grow the stack, so it's indexed instead of holding pointers into it.
+	std::size_t base = frame.stack.size();
+	frame.stack.resize(base + (function.is_native ? call_info.arguments.size() : function.declaration->locals));
+	for (std::size_t i = 0; i < call_info.arguments.size(); ++i)
 	{
-		function->function();
+		value_t argument = evaluate(*call_info.arguments[i], frame);
+		frame.stack[base + i] = std::move(argument);
 	}
-	else
-		throw std::exception("Non-native functions not implemented!");
 
-	return std::make_shared<runtime_value_t>(RUNTIME_VOID);
+	if (function.is_native)
+	{
+		value_t result = function.function(frame.stack.data() + base);
+		frame.stack.resize(base);
+		return result;
+	}
+
+	if (frame.call_depth >= max_call_depth)
+		throw std::runtime_error("Stack overflow calling " + function.debug_name + ", too many nested calls!");
+
+	const script_function_t& declaration = *function.declaration;
+
+	frame_t callee{ frame.environment, frame.stack, function.global_slots.data(), base, frame.call_depth + 1 };
+	exec_block(declaration.body, callee);
+	frame.stack.resize(base);
+
+	return callee.completion == COMPLETION_RETURN ? std::move(callee.result) : value_t{};
+}
+
+// Takes the break/continue a loop body finished with, returns true when the loop has to stop.
+bool end_iteration(frame_t& frame)
+{
+	switch (frame.completion)
+	{
+		case COMPLETION_BREAK:
+			frame.completion = COMPLETION_NORMAL;
+			return true;
+		case COMPLETION_CONTINUE:
+			frame.completion = COMPLETION_NORMAL;
+			return false;
+		case COMPLETION_RETURN:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void exec_while(const while_stmt_t& loop, frame_t& frame)
+{
+	while (is_truthy(evaluate(*loop.condition, frame)))
+	{
+		exec_statement(*loop.body, frame, false);
+		if (end_iteration(frame))
+			break;
+	}
 }
 
-void eval_program(std::unique_ptr<program_t> program, std::shared_ptr<environment_t> environment)
+void exec_for(const for_stmt_t& loop, frame_t& frame)
 {
-	std::int32_t current_statement = 0;
+	if (loop.initializer)
+		evaluate(*loop.initializer, frame);
 
-	for (std::unique_ptr<stmt_t>& stmt : program->statements)
+	while (!loop.condition || is_truthy(evaluate(*loop.condition, frame)))
 	{
-		std::shared_ptr<runtime_value_t> result = run_tree(std::move(stmt), environment);
-		// std::printf("Result [%d]:\n", ++current_statement);
-		result->dump();
+		exec_statement(*loop.body, frame, false);
+		if (end_iteration(frame))
+			break;
+
+		if (loop.step)
+			evaluate(*loop.step, frame);
 	}
 }
 
-std::shared_ptr<runtime_value_t> interpreter::run_tree(std::unique_ptr<stmt_t> current, std::shared_ptr<environment_t> environment)
+// Top level statements print their result, same as before there were blocks
+void exec_statement(const stmt_t& statement, frame_t& frame, bool top_level)
 {
-	switch (current->type)
+	switch (statement.type)
 	{
-		case STMT_PROGRAM:
+		case STMT_BLOCK:
+			exec_block(static_cast<const block_stmt_t&>(statement).statements, frame);
+			break;
+		case STMT_IF:
 		{
-			std::unique_ptr<program_t> program = cast_stmt(program_t, current);
-			eval_program(std::move(program), environment);
+			// else if chains in a loop
+			const if_stmt_t* branch = &static_cast<const if_stmt_t&>(statement);
+			const stmt_t* taken = nullptr;
+			while (!taken)
+			{
+				if (is_truthy(evaluate(*branch->condition, frame)))
+					taken = branch->then_branch.get();
+				else if (branch->else_branch && branch->else_branch->type == STMT_IF)
+					branch = static_cast<const if_stmt_t*>(branch->else_branch.get());
+				else if (branch->else_branch)
+					taken = branch->else_branch.get();
+				else
+					break;
+			}
+
+			if (taken)
+				exec_statement(*taken, frame, false);
 			break;
 		}
+		case STMT_WHILE:
+			exec_while(static_cast<const while_stmt_t&>(statement), frame);
+			break;
+		case STMT_FOR:
+			exec_for(static_cast<const for_stmt_t&>(statement), frame);
+			break;
+		case STMT_FUNCTION:
+		{
+			const function_stmt_t& declaration = static_cast<const function_stmt_t&>(statement);
+			assign(static_cast<const identifier_expr_t&>(*declaration.variable), make_function(declaration.function, frame.environment), frame);
+			break;
+		}
+		case STMT_RETURN:
+		{
+			const return_stmt_t& return_statement = static_cast<const return_stmt_t&>(statement);
+			frame.result = return_statement.value ? evaluate(*return_statement.value, frame) : value_t{};
+			frame.completion = COMPLETION_RETURN;
+			break;
+		}
+		case STMT_BREAK:
+			frame.completion = COMPLETION_BREAK;
+			break;
+		case STMT_CONTINUE:
+			frame.completion = COMPLETION_CONTINUE;
+			break;
+		default:
+		{
+			value_t result = evaluate(statement, frame);
+			if (top_level)
+				result.dump();
+			break;
+		}
+	}
+}
+
+value_t eval_program(const program_t& program, frame_t& frame)
+{
+	for (const ast_ptr_t<stmt_t>& stmt : program.statements)
+	{
+		exec_statement(*stmt, frame, true);
+		if (frame.completion == COMPLETION_RETURN)
+			return std::move(frame.result);
+	}
+
+	return {};
+}
+
+value_t evaluate(const stmt_t& current, frame_t& frame)
+{
+	switch (current.type)
+	{
 		case STMT_ASSIGNMENT:
 		{
-			std::unique_ptr<assignment_stmt_t> assignment = cast_stmt(assignment_stmt_t, current);
-			return eval_assignment(std::move(assignment), environment);
+			return eval_assignment(static_cast<const assignment_stmt_t&>(current), frame);
 		}
 		case STMT_CALL:
 		{
-			std::unique_ptr<call_stmt_t> call = cast_stmt(call_stmt_t, current);
-			eval_call(std::move(call), environment);
-			break;
+			return eval_call(static_cast<const call_stmt_t&>(current), frame);
 		}
 		case EXPR_BINARY:
 		{
-			std::unique_ptr<binary_expr_t> binary_expr = cast_stmt(binary_expr_t, current);
-			return eval_binop(std::move(binary_expr), environment);
+			return eval_binop(static_cast<const binary_expr_t&>(current), frame);
+		}
+		case EXPR_LOGICAL:
+		{
+			return eval_logical(static_cast<const logical_expr_t&>(current), frame);
 		}
 		case EXPR_UNARY:
 		{
-			std::unique_ptr<unary_expr_t> unary_expr = cast_stmt(unary_expr_t, current);
-			return eval_unary(std::move(unary_expr), environment);
+			return eval_unary(static_cast<const unary_expr_t&>(current), frame);
 		}
 		case EXPR_NEGATE:
 		{
-			std::unique_ptr<negate_expr_t> negate_expr = cast_stmt(negate_expr_t, current);
-			return eval_negate(std::move(negate_expr), environment);
+			return eval_negate(static_cast<const negate_expr_t&>(current), frame);
+		}
+		case EXPR_COMPLEMENT:
+		{
+			return eval_complement(static_cast<const complement_expr_t&>(current), frame);
 		}
 		case EXPR_PRIMARY:
 		{
-			std::unique_ptr<primary_expr_t> primary_expr = cast_stmt(primary_expr_t, current); // data is lost upon this conversion, just cast for the type.
-			return eval_primary(primary_expr->type, std::move(current), environment);
+			return eval_primary(static_cast<const primary_expr_t&>(current), frame);
 		}
 		default:
 		{
-			std::printf("[Runtime] Unexpected statement: %d\n", current->type);
+			std::printf("[Runtime] Unexpected statement: %d\n", current.type);
 			break;
 		}
 	}
 
-	return std::make_shared<runtime_value_t>(RUNTIME_VOID);
-}
\ No newline at end of file
+	return {};
+}
+
+value_t interpreter::run_tree(const stmt_t& current, environment_t& environment)
+{
+	std::vector<value_t> stack{};
+	std::vector<std::uint32_t> global_slots{};
+	frame_t frame{ environment, stack };
+
+	if (current.type != STMT_PROGRAM)
+		return evaluate(current, frame);
+
+	// Link the program's globals to the environment once, every access after this is just an index.
+	const program_t& program = static_cast<const program_t&>(current);
+	global_slots.resize(program.globals.size());
+	for (std::size_t i = 0; i < global_slots.size(); ++i)
+		global_slots[i] = environment.slot(program.globals[i]);
+	frame.global_slots = global_slots.data();
+
+	return eval_program(program, frame);
+}
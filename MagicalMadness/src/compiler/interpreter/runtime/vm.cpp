@@ -0,0 +1,419 @@
+#include "../include/vm.hpp"
+#include "../include/operations.hpp"
+#include "../include/profile.hpp"
+#include "../../jit/jit.hpp"
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+
+using namespace interpreter;
+
+constexpr std::uint64_t check_interval = 1024; // instructions between looks at the cancel flag
+
+static const std::atomic<bool> never_cancelled = false;
+
+static std::uint16_t read_u16(const std::uint8_t*& ip)
+{
+	std::uint16_t value = ip[0] | (ip[1] << 8);
+	ip += 2;
+	return value;
+}
+
+// Throws when the script has to stop, otherwise gives back when to look again
+static std::uint64_t check_limits(const execution_state_t& state, std::uint64_t executed)
+{
+	if (state.cancelled && state.cancelled->load(std::memory_order_relaxed))
+		throw std::runtime_error("Script was cancelled!");
+
+	if (state.max_instructions && executed >= state.max_instructions)
+		throw std::runtime_error("Script ran out of its budget of " + std::to_string(state.max_instructions) + " instructions!");
+
+	std::uint64_t next = executed + check_interval;
+	return state.max_instructions ? std::min(next, state.max_instructions) : next;
+}
+
+// Keeps the stack of functions being timed, instructions go to whichever one is running
+class profiler_t
+{
+private:
+	using clock_t = std::chrono::steady_clock;
+
+	struct entry_t
+	{
+		function_profile_t* function;
+		clock_t::time_point start;
+	};
+
+	script_profile_t& profile;
+	std::vector<entry_t> running{};
+	std::uint64_t attributed = 0;
+public:
+	profiler_t(script_profile_t& profile) : profile{ profile } {};
+
+	void enter(const void* key, const std::string& name, std::uint64_t executed)
+	{
+		function_profile_t& function = profile.functions[key];
+		if (function.name.empty())
+			function.name = name;
+
+		flush(executed);
+		++function.calls;
+		running.push_back({ &function, clock_t::now() });
+	}
+
+	void leave(std::uint64_t executed)
+	{
+		flush(executed);
+		running.back().function->milliseconds += std::chrono::duration<double, std::milli>(clock_t::now() - running.back().start).count();
+		running.pop_back();
+	}
+
+	void flush(std::uint64_t executed)
+	{
+		if (!running.empty())
+			running.back().function->instructions += executed - attributed;
+
+		attributed = executed;
+	}
+
+	// Calls that never became a frame (natives, machine code), executed already includes their instructions
+	void add(const void* key, const std::string& name, clock_t::time_point start, bool compiled, std::uint64_t instructions, std::uint64_t executed)
+	{
+		flush(executed - instructions);
+		attributed = executed;
+
+		function_profile_t& function = profile.functions[key];
+		if (function.name.empty())
+			function.name = name;
+
+		++function.calls;
+		function.compiled_calls += compiled;
+		function.instructions += instructions;
+		function.milliseconds += std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+	}
+
+	// Whatever was running when the script threw
+	void unwind(std::uint64_t executed)
+	{
+		while (!running.empty())
+			leave(executed);
+	}
+};
+
+// Runs until the chunk it starts in returns. The stack already holds its locals from base on.
+static value_t execute(const chunk_t& start, const std::uint32_t* start_slots, std::size_t start_base, const std::string& name, execution_state_t& state)
+{
+	std::vector<value_t>& stack = state.stack;
+	std::vector<call_frame_t>& frames = state.frames;
+	environment_t& environment = *state.global_env;
+	std::vector<value_t>& globals = environment.values;
+
+	// The running function, saved in frames while it calls something
+	const chunk_t* chunk = &start;
+	const std::uint8_t* ip = chunk->code.data();
+	const std::uint32_t* global_slots = start_slots;
+	std::size_t base = start_base;
+
+	std::uint64_t executed = 0;
+	std::uint64_t next_check = state.max_instructions || state.cancelled ? 0 : UINT64_MAX;
+
+	script_profile_t* profile = state.profile;
+	std::optional<profiler_t> profiler{};
+	if (profile)
+	{
+		profiler.emplace(*profile);
+		profiler->enter(&start, name, 0);
+	}
+
+	try
+	{
+		while (true)
+		{
+			opcode_t op = static_cast<opcode_t>(*ip++);
+			++executed;
+			if (profile)
+				++profile->opcodes[op];
+
+			switch (op)
+			{
+				case OP_CONSTANT:
+					state.push_stack(chunk->constants[read_u16(ip)]);
+					break;
+				case OP_VOID:
+					stack.emplace_back();
+					break;
+				case OP_GET_GLOBAL:
+					state.push_stack(globals[global_slots[read_u16(ip)]]);
+					break;
+				case OP_SET_GLOBAL:
+					globals[global_slots[read_u16(ip)]] = stack.back();
+					break;
+				case OP_GET_LOCAL:
+					state.push_stack(stack[base + read_u16(ip)]);
+					break;
+				case OP_SET_LOCAL:
+				{
+					std::size_t slot = base + read_u16(ip);
+					stack[slot] = stack.back();
+					break;
+				}
+				case OP_POP:
+					stack.pop_back();
+					break;
+				case OP_ADD:
+				case OP_SUBTRACT:
+				case OP_MULTIPLY:
+				case OP_DIVIDE:
+				case OP_MODULO:
+				case OP_POWER:
+				case OP_AND:
+				case OP_OR:
+				case OP_XOR:
+				case OP_SHIFT_LEFT:
+				case OP_SHIFT_RIGHT:
+				case OP_EQUAL:
+				case OP_NOT_EQUAL:
+				case OP_LESS:
+				case OP_LESS_EQUAL:
+				case OP_GREATER:
+				case OP_GREATER_EQUAL:
+				{
+					value_t& left = stack[stack.size() - 2];
+					left = arithmetic(static_cast<binary_operator_t>(op - OP_ADD), left, stack.back());
+					stack.pop_back();
+					break;
+				}
+				case OP_NOT:
+					stack.back() = logical_not(stack.back());
+					break;
+				case OP_NEGATE:
+					stack.back() = negate(stack.back());
+					break;
+				case OP_COMPLEMENT:
+					stack.back() = complement(stack.back());
+					break;
+				case OP_JUMP:
+				{
+					std::uint16_t distance = read_u16(ip);
+					ip += distance;
+					break;
+				}
+				case OP_JUMP_IF_FALSE:
+				{
+					std::uint16_t distance = read_u16(ip);
+					if (!is_truthy(state.pop_stack()))
+						ip += distance;
+					break;
+				}
+				case OP_JUMP_IF_FALSE_OR_POP:
+				case OP_JUMP_IF_TRUE_OR_POP:
+				{
+					std::uint16_t distance = read_u16(ip);
+					if (is_truthy(stack.back()) == (op == OP_JUMP_IF_TRUE_OR_POP))
+						ip += distance;
+					else
+						stack.pop_back();
+					break;
+				}
+				case OP_LOOP:
+				{
+					std::uint16_t distance = read_u16(ip);
+					ip -= distance;
+					if (executed >= next_check)
+						next_check = check_limits(state, executed);
+					break;
+				}
+				case OP_LOOP_IF_TRUE:
+				{
+					std::uint16_t distance = read_u16(ip);
+					if (is_truthy(state.pop_stack()))
+					{
+						ip -= distance;
+						if (executed >= next_check)
+							next_check = check_limits(state, executed);
+					}
+					break;
+				}
+				case OP_FUNCTION:
+					stack.push_back(make_function(chunk->functions[read_u16(ip)], environment));
+					break;
+				case OP_CALL:
+				case OP_TAIL_CALL:
+				{
+					std::uint8_t argument_count = *ip++;
+					std::size_t callee_slot = stack.size() - 1 - argument_count;
+					value_t& callee = stack[callee_slot];
+
+					if (callee.type != RUNTIME_FUNCTION)
+						throw std::runtime_error("Attempt to call a value that isn't a function!");
+
+					runtime_function_t& function = callee.as_function();
+					check_arguments(function, argument_count);
+
+					if (executed >= next_check)
+						next_check = check_limits(state, executed);
+
+					auto start = profiler ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+					if (function.is_native)
+					{
+						// Arguments are read straight off the stack, then the function & arguments are replaced by the result
+						value_t result = function.function(stack.data() + stack.size() - argument_count);
+
+						stack.resize(stack.size() - argument_count);
+						stack.back() = std::move(result);
+
+						if (profiler)
+							profiler->add(reinterpret_cast<const void*>(function.function), function.debug_name, start, false, 0, executed);
+						break;
+					}
+
+					const script_function_t& declaration = *function.declaration;
+
+					// Hot integer functions run as machine code, the VM only runs the call when that can't finish it
+					if (const jit_code_t* native = jit::hot_code(declaration))
+					{
+						jit_limits_t limits{};
+						limits.cancelled = state.cancelled ? state.cancelled : &never_cancelled;
+						if (state.max_instructions)
+							limits.fuel = static_cast<std::int64_t>(state.max_instructions - std::min(executed, state.max_instructions));
+
+						std::int64_t fuel = limits.fuel;
+						value_t result{};
+						if (native->run(stack.data() + callee_slot + 1, argument_count, result, limits))
+						{
+							stack.resize(callee_slot);
+							stack.push_back(std::move(result));
+
+							// Every loop iteration is charged as one instruction
+							std::uint64_t iterations = fuel - limits.fuel;
+							executed += iterations;
+							if (profiler)
+								profiler->add(declaration.chunk.get(), function.debug_name, start, true, iterations, executed);
+							break;
+						}
+					}
+
+					if (op == OP_TAIL_CALL)
+					{
+						// return f(...): nothing of the running call is needed anymore, the function & arguments move down over it and the callee
+						// returns straight to this call's caller. Tail recursion runs in one frame however deep it goes.
+						std::move(stack.begin() + callee_slot, stack.end(), stack.begin() + (base - 1));
+						stack.resize(base + argument_count);
+
+						if (profiler)
+							profiler->leave(executed);
+					}
+					else
+					{
+						if (frames.size() >= max_vm_call_depth)
+							throw std::runtime_error("Stack overflow calling " + function.debug_name + ", too many nested calls!");
+
+						// The arguments already are the first locals, the function stays below them so it lives until the call returns
+						frames.push_back({ chunk, ip, global_slots, base });
+						base = callee_slot + 1;
+					}
+
+					chunk = declaration.chunk.get();
+					ip = chunk->code.data();
+					global_slots = function.global_slots.data();
+
+					stack.resize(base + declaration.locals);
+
+					if (profiler)
+						profiler->enter(chunk, function.debug_name, executed);
+					break;
+				}
+				case OP_DUMP:
+					state.pop_stack().dump();
+					break;
+				case OP_RETURN:
+				{
+					value_t result = stack.empty() ? value_t{} : state.pop_stack();
+					if (profiler)
+						profiler->leave(executed);
+
+					if (frames.empty())
+					{
+						state.instructions = executed;
+						return result;
+					}
+
+					// Drop the locals and the function, the result takes the function's place
+					stack.resize(base - 1);
+					stack.push_back(std::move(result));
+
+					const call_frame_t& caller = frames.back();
+					chunk = caller.chunk;
+					ip = caller.ip;
+					global_slots = caller.global_slots;
+					base = caller.base;
+					frames.pop_back();
+					break;
+				}
+				default:
+					throw std::runtime_error("[VM] Unknown opcode: " + std::to_string(op));
+			}
+		}
+	}
+	catch (...)
+	{
+		// A cancelled script is the one most worth looking at
+		state.instructions = executed;
+		if (profiler)
+			profiler->unwind(executed);
+		throw;
+	}
+}
+
+value_t interpreter::run_bytecode(const chunk_t& program, execution_state_t& state)
+{
+	state.stack.clear();
+	state.frames.clear();
+	state.stack.reserve(program.max_stack);
+
+	// Link the chunk's globals to the environment once, every access after this is just an index.
+	environment_t& environment = *state.global_env;
+	state.global_slots.resize(program.names.size());
+	for (std::size_t i = 0; i < program.names.size(); ++i)
+		state.global_slots[i] = environment.slot(program.names[i]);
+
+	static const std::string name = "<script>";
+	return execute(program, state.global_slots.data(), 0, name, state);
+}
+
+value_t interpreter::call_function(const value_t& function, const value_t* arguments, std::size_t count, execution_state_t& state)
+{
+	if (function.type != RUNTIME_FUNCTION)
+		throw std::runtime_error("Attempt to call a value that isn't a function!");
+
+	const runtime_function_t& callee = function.as_function();
+	check_arguments(callee, count);
+
+	if (callee.is_native)
+		return callee.function(arguments);
+
+	const script_function_t& declaration = *callee.declaration;
+	if (const jit_code_t* native = jit::hot_code(declaration))
+	{
+		jit_limits_t limits{};
+		limits.cancelled = state.cancelled ? state.cancelled : &never_cancelled;
+		if (state.max_instructions)
+			limits.fuel = static_cast<std::int64_t>(state.max_instructions);
+
+		value_t result{};
+		if (native->run(arguments, count, result, limits))
+			return result;
+	}
+
+	// Same layout a call from the VM leaves: the function, then its arguments as the first locals
+	state.stack.clear();
+	state.frames.clear();
+	state.stack.reserve(1 + declaration.locals + declaration.chunk->max_stack);
+	state.stack.push_back(function);
+	state.stack.insert(state.stack.end(), arguments, arguments + count);
+	state.stack.resize(1 + declaration.locals);
+
+	return execute(*declaration.chunk, callee.global_slots.data(), 1, callee.debug_name, state);
+}
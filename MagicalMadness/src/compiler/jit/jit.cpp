@@ -0,0 +1,766 @@
+#ifndef ZYDIS_STATIC_BUILD
+#define ZYDIS_STATIC_BUILD
+#endif
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <Zydis/Zydis.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <stdexcept>
+#include <sys/mman.h>
+#endif
+
+#include "jit.hpp"
+#include "../optimizer/optimizer.hpp"
+#include "../resolver/resolver.hpp"
+#include "../bytecode/compiler.hpp"
+
+jit_code_t::jit_code_t(const std::vector<std::uint8_t>& code) : size{ code.size() }
+{
+	// Written while it's read/write, then flipped to read/execute so the memory is never both
+#ifdef _WIN32
+	memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!memory)
+		throw std::runtime_error("[JIT] Failed to allocate memory for machine code!");
+
+	std::memcpy(memory, code.data(), size);
+
+	DWORD old_protection = 0;
+	if (!VirtualProtect(memory, size, PAGE_EXECUTE_READ, &old_protection))
+	{
+		VirtualFree(memory, 0, MEM_RELEASE);
+		throw std::runtime_error("[JIT] Failed to make machine code executable!");
+	}
+
+	FlushInstructionCache(GetCurrentProcess(), memory, size);
+#else
+	memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		throw std::runtime_error("[JIT] Failed to allocate memory for machine code!");
+
+	std::memcpy(memory, code.data(), size);
+
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(memory, size);
+		throw std::runtime_error("[JIT] Failed to make machine code executable!");
+	}
+#endif
+
+	entry = reinterpret_cast<jit_entry_t>(memory);
+}
+
+jit_code_t::~jit_code_t()
+{
+#ifdef _WIN32
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+}
+
+bool jit_code_t::run(const value_t* arguments, std::size_t count, value_t& result, jit_limits_t& limits) const
+{
+	// Only the arguments need a value, jit::is_supported made sure every other local is assigned before it's read
+	std::int64_t locals[jit::max_locals];
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		if (arguments[i].type != RUNTIME_INTEGER)
+			return false;
+
+		locals[i] = arguments[i].integer;
+	}
+
+	std::int64_t value = 0;
+	switch (entry(locals, &value, &limits))
+	{
+		case JIT_INTEGER:
+			result = value_t{ value };
+			return true;
+		case JIT_VOID:
+			result = {};
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Walks a function the way it runs, tracking which locals are surely assigned by now. Reading a local that was never assigned gives void
+// in the VM, the machine code only has integers, so a function that might do that stays in the VM.
+// Statements run in order, so what one assigns is assigned for the ones after it in the same body. Bodies of branches and loops might not run,
+// what they assign is forgotten after them (unless both sides of an if assign it).
+class jit_checker_t
+{
+private:
+	std::vector<bool> assigned{};
+
+	// Compiling recurses once per level, deeper expressions (long generated chains) stay in the VM
+	static constexpr std::size_t max_depth = 64;
+
+	bool check_expression(const stmt_t& node, std::size_t depth = 0) const
+	{
+		if (depth > max_depth)
+			return false;
+
+		switch (node.type)
+		{
+			case EXPR_PRIMARY:
+			{
+				const primary_expr_t& primary = static_cast<const primary_expr_t&>(node);
+				if (primary.type == PRIMARY_INTEGER)
+					return true;
+				if (primary.type != PRIMARY_IDENTIFIER)
+					return false;
+
+				const identifier_expr_t& identifier = static_cast<const identifier_expr_t&>(primary);
+				return identifier.depth != 0 && assigned[identifier.slot];
+			}
+			case EXPR_BINARY:
+			{
+				// Power can give back a float (negative exponents)
+				const binary_expr_t& binary = static_cast<const binary_expr_t&>(node);
+				return binary.operand != BINARY_POWER && check_expression(*binary.left, depth + 1) && check_expression(*binary.right, depth + 1);
+			}
+			case EXPR_LOGICAL:
+			{
+				const logical_expr_t& logical = static_cast<const logical_expr_t&>(node);
+				return check_expression(*logical.left, depth + 1) && check_expression(*logical.right, depth + 1);
+			}
+			case EXPR_UNARY:
+				return check_expression(*static_cast<const unary_expr_t&>(node).child, depth + 1);
+			case EXPR_NEGATE:
+				return check_expression(*static_cast<const negate_expr_t&>(node).child, depth + 1);
+			case EXPR_COMPLEMENT:
+				return check_expression(*static_cast<const complement_expr_t&>(node).child, depth + 1);
+			default:
+				return false; // calls
+		}
+	}
+
+	// Checks a body that might not run, leaving assigned as it was before it
+	bool check_body(const stmt_t& body)
+	{
+		std::vector<bool> before = assigned;
+		bool supported = check_statement(body);
+		assigned = std::move(before);
+		return supported;
+	}
+
+	bool check_statement(const stmt_t& statement)
+	{
+		switch (statement.type)
+		{
+			case STMT_ASSIGNMENT:
+			{
+				const assignment_stmt_t& assignment = static_cast<const assignment_stmt_t&>(statement);
+				if (assignment.variable->type != EXPR_PRIMARY || static_cast<const primary_expr_t&>(*assignment.variable).type != PRIMARY_IDENTIFIER)
+					return false;
+
+				const identifier_expr_t& identifier = static_cast<const identifier_expr_t&>(*assignment.variable);
+				if (identifier.depth == 0 || !check_expression(*assignment.assignment))
+					return false;
+
+				assigned[identifier.slot] = true;
+				return true;
+			}
+			case STMT_BLOCK:
+			{
+				for (const ast_ptr_t<stmt_t>& child : static_cast<const block_stmt_t&>(statement).statements)
+				{
+					if (!check_statement(*child))
+						return false;
+				}
+				return true;
+			}
+			case STMT_IF:
+			{
+				// else if chains in a loop. Afterwards a local is surely assigned when every branch assigned it, without a final else
+				// not taking any branch is one of them
+				std::vector<const if_stmt_t*> chain = if_chain(static_cast<const if_stmt_t&>(statement));
+				const stmt_t* otherwise = chain.back()->else_branch.get();
+
+				std::vector<bool> before = assigned;
+				std::vector<bool> after = otherwise ? std::vector<bool>(assigned.size(), true) : before;
+				auto merge = [&]()
+				{
+					for (std::size_t i = 0; i < after.size(); ++i)
+						after[i] = after[i] && assigned[i];
+					assigned = before;
+				};
+
+				for (const if_stmt_t* branch : chain)
+				{
+					if (!check_expression(*branch->condition) || !check_statement(*branch->then_branch))
+						return false;
+					merge();
+				}
+
+				if (otherwise)
+				{
+					if (!check_statement(*otherwise))
+						return false;
+					merge();
+				}
+
+				assigned = std::move(after);
+				return true;
+			}
+			case STMT_WHILE:
+			{
+				const while_stmt_t& loop = static_cast<const while_stmt_t&>(statement);
+				return check_expression(*loop.condition) && check_body(*loop.body);
+			}
+			case STMT_FOR:
+			{
+				const for_stmt_t& loop = static_cast<const for_stmt_t&>(statement);
+				return (!loop.initializer || check_statement(*loop.initializer)) && (!loop.condition || check_expression(*loop.condition))
+					&& check_body(*loop.body) && (!loop.step || check_body(*loop.step));
+			}
+			case STMT_RETURN:
+			{
+				const return_stmt_t& return_statement = static_cast<const return_stmt_t&>(statement);
+				return !return_statement.value || check_expression(*return_statement.value);
+			}
+			case STMT_BREAK:
+			case STMT_CONTINUE:
+				return true;
+			default:
+				return check_expression(statement);
+		}
+	}
+public:
+	bool check(const script_function_t& function)
+	{
+		if (function.locals > jit::max_locals || !function.globals.empty())
+			return false;
+
+		assigned.assign(function.locals, false);
+		std::fill_n(assigned.begin(), function.parameters.size(), true);
+
+		for (const ast_ptr_t<stmt_t>& statement : function.body)
+		{
+			if (!check_statement(*statement))
+				return false;
+		}
+
+		return true;
+	}
+};
+
+bool jit::is_supported(const script_function_t& function)
+{
+	jit_checker_t checker{};
+	return checker.check(function);
+}
+
+#ifdef JIT_X64
+
+// rbx points at the locals, r12 at the result and r13 at the jit_limits_t for the whole function, rax/rcx/rdx are scratch. Expressions leave their value in rax.
+#ifdef _WIN32
+static constexpr ZydisRegister first_argument = ZYDIS_REGISTER_RCX;
+static constexpr ZydisRegister second_argument = ZYDIS_REGISTER_RDX;
+static constexpr ZydisRegister third_argument = ZYDIS_REGISTER_R8;
+#else
+static constexpr ZydisRegister first_argument = ZYDIS_REGISTER_RDI;
+static constexpr ZydisRegister second_argument = ZYDIS_REGISTER_RSI;
+static constexpr ZydisRegister third_argument = ZYDIS_REGISTER_RDX;
+#endif
+
+static ZydisEncoderOperand reg(ZydisRegister value)
+{
+	ZydisEncoderOperand operand{};
+	operand.type = ZYDIS_OPERAND_TYPE_REGISTER;
+	operand.reg.value = value;
+	return operand;
+}
+
+static ZydisEncoderOperand imm(std::int64_t value)
+{
+	ZydisEncoderOperand operand{};
+	operand.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
+	operand.imm.s = value;
+	return operand;
+}
+
+static ZydisEncoderOperand memory(ZydisRegister base, std::int64_t displacement = 0, std::uint16_t size = sizeof(std::int64_t))
+{
+	ZydisEncoderOperand operand{};
+	operand.type = ZYDIS_OPERAND_TYPE_MEMORY;
+	operand.mem.base = base;
+	operand.mem.displacement = displacement;
+	operand.mem.size = size;
+	return operand;
+}
+
+static ZydisEncoderOperand local(std::uint32_t slot)
+{
+	return memory(ZYDIS_REGISTER_RBX, static_cast<std::int64_t>(slot) * sizeof(std::int64_t));
+}
+
+// Straight from the tree, one expression at a time with no register allocation. Still no dispatch, no value_t and no type checks per operation.
+class jit_compiler_t
+{
+private:
+	// Jumps always get a 32 bit distance and are patched once the target is known, these are the offsets right after them
+	struct loop_t
+	{
+		std::vector<std::size_t> breaks{};
+		std::vector<std::size_t> continues{};
+	};
+
+	std::vector<std::uint8_t> code{};
+	std::vector<std::size_t> returns{};
+	std::vector<std::size_t> bails{};
+	std::vector<loop_t> loops{};
+
+	void emit(ZydisMnemonic mnemonic, std::initializer_list<ZydisEncoderOperand> operands, bool branch = false)
+	{
+		ZydisEncoderRequest request{};
+		request.machine_mode = ZYDIS_MACHINE_MODE_LONG_64;
+		request.mnemonic = mnemonic;
+		request.operand_count = static_cast<ZyanU8>(operands.size());
+		std::copy(operands.begin(), operands.end(), request.operands);
+
+		if (branch)
+		{
+			request.branch_type = ZYDIS_BRANCH_TYPE_NEAR;
+			request.branch_width = ZYDIS_BRANCH_WIDTH_32;
+		}
+
+		std::uint8_t instruction[ZYDIS_MAX_INSTRUCTION_LENGTH];
+		ZyanUSize length = sizeof(instruction);
+		if (ZYAN_FAILED(ZydisEncoderEncodeInstruction(&request, instruction, &length)))
+			throw std::runtime_error("[JIT] Failed to encode an instruction!");
+
+		code.insert(code.end(), instruction, instruction + length);
+	}
+
+	std::size_t emit_jump(ZydisMnemonic mnemonic)
+	{
+		emit(mnemonic, { imm(0) }, true);
+		return code.size();
+	}
+
+	void patch_jump(std::size_t jump, std::size_t target)
+	{
+		std::int32_t distance = static_cast<std::int32_t>(target) - static_cast<std::int32_t>(jump);
+		std::memcpy(code.data() + jump - sizeof(distance), &distance, sizeof(distance));
+	}
+
+	void patch_jumps(std::vector<std::size_t>& jumps, std::size_t target)
+	{
+		for (std::size_t jump : jumps)
+			patch_jump(jump, target);
+
+		jumps.clear();
+	}
+
+	static bool is_simple(const stmt_t& node)
+	{
+		return node.type == EXPR_PRIMARY;
+	}
+
+	// Constants & locals straight into a register
+	void load_simple(ZydisRegister destination, const stmt_t& node)
+	{
+		const primary_expr_t& primary = static_cast<const primary_expr_t&>(node);
+		if (primary.type == PRIMARY_INTEGER)
+			emit(ZYDIS_MNEMONIC_MOV, { reg(destination), imm(static_cast<const integer_expr_t&>(primary).value) });
+		else
+			emit(ZYDIS_MNEMONIC_MOV, { reg(destination), local(static_cast<const identifier_expr_t&>(primary).slot) });
+	}
+
+	// rax = rax op rcx, same results as interpreter::integer_arithmetic
+	void compile_binary(const binary_expr_t& binary)
+	{
+		compile_expression(*binary.left);
+		if (is_simple(*binary.right))
+			load_simple(ZYDIS_REGISTER_RCX, *binary.right);
+		else
+		{
+			emit(ZYDIS_MNEMONIC_PUSH, { reg(ZYDIS_REGISTER_RAX) });
+			compile_expression(*binary.right);
+			emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_RCX), reg(ZYDIS_REGISTER_RAX) });
+			emit(ZYDIS_MNEMONIC_POP, { reg(ZYDIS_REGISTER_RAX) });
+		}
+
+		const ZydisEncoderOperand rax = reg(ZYDIS_REGISTER_RAX);
+		const ZydisEncoderOperand rcx = reg(ZYDIS_REGISTER_RCX);
+
+		switch (binary.operand)
+		{
+			case BINARY_ADD:
+				emit(ZYDIS_MNEMONIC_ADD, { rax, rcx });
+				break;
+			case BINARY_SUBTRACT:
+				emit(ZYDIS_MNEMONIC_SUB, { rax, rcx });
+				break;
+			case BINARY_MULTIPLY:
+				emit(ZYDIS_MNEMONIC_IMUL, { rax, rcx });
+				break;
+			case BINARY_DIVIDE:
+			case BINARY_MODULO:
+			{
+				// By zero throws, that's the VM's job
+				emit(ZYDIS_MNEMONIC_TEST, { rcx, rcx });
+				bails.push_back(emit_jump(ZYDIS_MNEMONIC_JZ));
+
+				// INT64_MIN / -1 traps, -1 is done by hand
+				emit(ZYDIS_MNEMONIC_CMP, { rcx, imm(-1) });
+				std::size_t divide = emit_jump(ZYDIS_MNEMONIC_JNZ);
+				if (binary.operand == BINARY_DIVIDE)
+					emit(ZYDIS_MNEMONIC_NEG, { rax });
+				else
+					emit(ZYDIS_MNEMONIC_XOR, { reg(ZYDIS_REGISTER_EAX), reg(ZYDIS_REGISTER_EAX) });
+				std::size_t done = emit_jump(ZYDIS_MNEMONIC_JMP);
+
+				patch_jump(divide, code.size());
+				emit(ZYDIS_MNEMONIC_CQO, {});
+				emit(ZYDIS_MNEMONIC_IDIV, { rcx });
+				if (binary.operand == BINARY_MODULO)
+					emit(ZYDIS_MNEMONIC_MOV, { rax, reg(ZYDIS_REGISTER_RDX) });
+
+				patch_jump(done, code.size());
+				break;
+			}
+			case BINARY_AND:
+				emit(ZYDIS_MNEMONIC_AND, { rax, rcx });
+				break;
+			case BINARY_OR:
+				emit(ZYDIS_MNEMONIC_OR, { rax, rcx });
+				break;
+			case BINARY_XOR:
+				emit(ZYDIS_MNEMONIC_XOR, { rax, rcx });
+				break;
+			case BINARY_SHIFT_LEFT: // the CPU masks the count with 63 same as the runtime does
+				emit(ZYDIS_MNEMONIC_SHL, { rax, reg(ZYDIS_REGISTER_CL) });
+				break;
+			case BINARY_SHIFT_RIGHT:
+				emit(ZYDIS_MNEMONIC_SHR, { rax, reg(ZYDIS_REGISTER_CL) });
+				break;
+			default:
+			{
+				static constexpr ZydisMnemonic set[] = { ZYDIS_MNEMONIC_SETZ, ZYDIS_MNEMONIC_SETNZ, ZYDIS_MNEMONIC_SETL, ZYDIS_MNEMONIC_SETLE, ZYDIS_MNEMONIC_SETNLE, ZYDIS_MNEMONIC_SETNL };
+
+				emit(ZYDIS_MNEMONIC_CMP, { rax, rcx });
+				emit(set[binary.operand - BINARY_EQUAL], { reg(ZYDIS_REGISTER_AL) });
+				emit(ZYDIS_MNEMONIC_MOVZX, { reg(ZYDIS_REGISTER_EAX), reg(ZYDIS_REGISTER_AL) });
+				break;
+			}
+		}
+	}
+
+	void compile_expression(const stmt_t& node)
+	{
+		const ZydisEncoderOperand rax = reg(ZYDIS_REGISTER_RAX);
+
+		switch (node.type)
+		{
+			case EXPR_PRIMARY:
+				load_simple(ZYDIS_REGISTER_RAX, node);
+				break;
+			case EXPR_BINARY:
+				compile_binary(static_cast<const binary_expr_t&>(node));
+				break;
+			case EXPR_LOGICAL:
+			{
+				// The left value is the result when it decides, like in the VM
+				const logical_expr_t& logical = static_cast<const logical_expr_t&>(node);
+				compile_expression(*logical.left);
+				emit(ZYDIS_MNEMONIC_TEST, { rax, rax });
+				std::size_t decided = emit_jump(logical.is_and ? ZYDIS_MNEMONIC_JZ : ZYDIS_MNEMONIC_JNZ);
+				compile_expression(*logical.right);
+				patch_jump(decided, code.size());
+				break;
+			}
+			case EXPR_UNARY:
+				compile_expression(*static_cast<const unary_expr_t&>(node).child);
+				emit(ZYDIS_MNEMONIC_TEST, { rax, rax });
+				emit(ZYDIS_MNEMONIC_SETZ, { reg(ZYDIS_REGISTER_AL) });
+				emit(ZYDIS_MNEMONIC_MOVZX, { reg(ZYDIS_REGISTER_EAX), reg(ZYDIS_REGISTER_AL) });
+				break;
+			case EXPR_NEGATE:
+				compile_expression(*static_cast<const negate_expr_t&>(node).child);
+				emit(ZYDIS_MNEMONIC_NEG, { rax });
+				break;
+			case EXPR_COMPLEMENT:
+				compile_expression(*static_cast<const complement_expr_t&>(node).child);
+				emit(ZYDIS_MNEMONIC_NOT, { rax });
+				break;
+			case STMT_ASSIGNMENT:
+			{
+				const assignment_stmt_t& assignment = static_cast<const assignment_stmt_t&>(node);
+				compile_expression(*assignment.assignment);
+				emit(ZYDIS_MNEMONIC_MOV, { local(static_cast<const identifier_expr_t&>(*assignment.variable).slot), rax });
+				break;
+			}
+			default:
+				throw std::runtime_error("[JIT] Unexpected expression!");
+		}
+	}
+
+	void end_loop(std::size_t continue_target, std::size_t break_target)
+	{
+		patch_jumps(loops.back().continues, continue_target);
+		patch_jumps(loops.back().breaks, break_target);
+		loops.pop_back();
+	}
+
+	// Top of every loop iteration, nothing is live here
+	void check_limits()
+	{
+		emit(ZYDIS_MNEMONIC_SUB, { memory(ZYDIS_REGISTER_R13, offsetof(jit_limits_t, fuel)), imm(1) });
+		bails.push_back(emit_jump(ZYDIS_MNEMONIC_JL));
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_RAX), memory(ZYDIS_REGISTER_R13, offsetof(jit_limits_t, cancelled)) });
+		emit(ZYDIS_MNEMONIC_CMP, { memory(ZYDIS_REGISTER_RAX, 0, sizeof(bool)), imm(0) });
+		bails.push_back(emit_jump(ZYDIS_MNEMONIC_JNZ));
+	}
+
+	void compile_statement(const stmt_t& statement)
+	{
+		const ZydisEncoderOperand rax = reg(ZYDIS_REGISTER_RAX);
+
+		switch (statement.type)
+		{
+			case STMT_BLOCK:
+				for (const ast_ptr_t<stmt_t>& child : static_cast<const block_stmt_t&>(statement).statements)
+					compile_statement(*child);
+				break;
+			case STMT_IF:
+			{
+				// else if chains in a loop
+				std::vector<const if_stmt_t*> chain = if_chain(static_cast<const if_stmt_t&>(statement));
+				const stmt_t* otherwise = chain.back()->else_branch.get();
+
+				std::vector<std::size_t> ends{};
+				for (const if_stmt_t* branch : chain)
+				{
+					compile_expression(*branch->condition);
+					emit(ZYDIS_MNEMONIC_TEST, { rax, rax });
+					std::size_t next = emit_jump(ZYDIS_MNEMONIC_JZ);
+					compile_statement(*branch->then_branch);
+
+					if (branch != chain.back() || otherwise)
+						ends.push_back(emit_jump(ZYDIS_MNEMONIC_JMP));
+					patch_jump(next, code.size());
+				}
+
+				if (otherwise)
+					compile_statement(*otherwise);
+				patch_jumps(ends, code.size());
+				break;
+			}
+			case STMT_WHILE:
+			{
+				// Condition at the bottom like the bytecode, one jump per iteration
+				const while_stmt_t& loop = static_cast<const while_stmt_t&>(statement);
+				std::size_t entry = emit_jump(ZYDIS_MNEMONIC_JMP);
+				std::size_t body = code.size();
+				check_limits();
+				loops.emplace_back();
+				compile_statement(*loop.body);
+
+				std::size_t condition = code.size();
+				patch_jump(entry, condition);
+				compile_expression(*loop.condition);
+				emit(ZYDIS_MNEMONIC_TEST, { rax, rax });
+				patch_jump(emit_jump(ZYDIS_MNEMONIC_JNZ), body);
+				end_loop(condition, code.size());
+				break;
+			}
+			case STMT_FOR:
+			{
+				const for_stmt_t& loop = static_cast<const for_stmt_t&>(statement);
+				if (loop.initializer)
+					compile_expression(*loop.initializer);
+
+				std::size_t entry = emit_jump(ZYDIS_MNEMONIC_JMP);
+				std::size_t body = code.size();
+				check_limits();
+				loops.emplace_back();
+				compile_statement(*loop.body);
+
+				std::size_t step = code.size();
+				if (loop.step)
+					compile_expression(*loop.step);
+
+				patch_jump(entry, code.size());
+				if (loop.condition)
+				{
+					compile_expression(*loop.condition);
+					emit(ZYDIS_MNEMONIC_TEST, { rax, rax });
+					patch_jump(emit_jump(ZYDIS_MNEMONIC_JNZ), body);
+				}
+				else
+					patch_jump(emit_jump(ZYDIS_MNEMONIC_JMP), body);
+
+				end_loop(step, code.size());
+				break;
+			}
+			case STMT_RETURN:
+			{
+				const return_stmt_t& return_statement = static_cast<const return_stmt_t&>(statement);
+				if (return_statement.value)
+				{
+					compile_expression(*return_statement.value);
+					emit(ZYDIS_MNEMONIC_MOV, { memory(ZYDIS_REGISTER_R12), rax });
+					emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_EAX), imm(JIT_INTEGER) });
+				}
+				else
+					emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_EAX), imm(JIT_VOID) });
+
+				returns.push_back(emit_jump(ZYDIS_MNEMONIC_JMP));
+				break;
+			}
+			case STMT_BREAK:
+				loops.back().breaks.push_back(emit_jump(ZYDIS_MNEMONIC_JMP));
+				break;
+			case STMT_CONTINUE:
+				loops.back().continues.push_back(emit_jump(ZYDIS_MNEMONIC_JMP));
+				break;
+			default:
+				compile_expression(statement); // result isn't used
+				break;
+		}
+	}
+public:
+	jit_compiler_t() = default;
+	jit_compiler_t(const jit_compiler_t&) = delete;
+
+	std::shared_ptr<const jit_code_t> compile(const script_function_t& function)
+	{
+		// rbx, r12, r13 & rbp belong to the caller in both calling conventions. Nothing here calls out so alignment doesn't matter, rbp keeps
+		// rsp from after the pushes because a bail can leave from inside an expression with temporaries still pushed
+		emit(ZYDIS_MNEMONIC_PUSH, { reg(ZYDIS_REGISTER_RBX) });
+		emit(ZYDIS_MNEMONIC_PUSH, { reg(ZYDIS_REGISTER_R12) });
+		emit(ZYDIS_MNEMONIC_PUSH, { reg(ZYDIS_REGISTER_R13) });
+		emit(ZYDIS_MNEMONIC_PUSH, { reg(ZYDIS_REGISTER_RBP) });
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_RBP), reg(ZYDIS_REGISTER_RSP) });
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_RBX), reg(first_argument) });
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_R12), reg(second_argument) });
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_R13), reg(third_argument) });
+
+		for (const ast_ptr_t<stmt_t>& statement : function.body)
+			compile_statement(*statement);
+
+		// Falling off the end returns void
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_EAX), imm(JIT_VOID) });
+
+		std::size_t epilogue = code.size();
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_RSP), reg(ZYDIS_REGISTER_RBP) });
+		emit(ZYDIS_MNEMONIC_POP, { reg(ZYDIS_REGISTER_RBP) });
+		emit(ZYDIS_MNEMONIC_POP, { reg(ZYDIS_REGISTER_R13) });
+		emit(ZYDIS_MNEMONIC_POP, { reg(ZYDIS_REGISTER_R12) });
+		emit(ZYDIS_MNEMONIC_POP, { reg(ZYDIS_REGISTER_RBX) });
+		emit(ZYDIS_MNEMONIC_RET, {});
+
+		std::size_t bail = code.size();
+		emit(ZYDIS_MNEMONIC_MOV, { reg(ZYDIS_REGISTER_EAX), imm(JIT_BAIL) });
+		patch_jump(emit_jump(ZYDIS_MNEMONIC_JMP), epilogue);
+
+		patch_jumps(returns, epilogue);
+		patch_jumps(bails, bail);
+
+		return std::make_shared<const jit_code_t>(code);
+	}
+};
+
+#endif
+
+// Functions loaded from a script cache file have no tree, their declaration is parsed, optimized & resolved again on its own. That's only
+// used when it compiles to exactly the bytecode that was loaded, so the machine code does what the VM would.
+static std::unique_ptr<program_t> parse_again(const script_function_t& function)
+{
+	std::string_view declaration = std::string_view{ *function.source }.substr(function.source_offset, function.source_length);
+
+	parser_t parser{ declaration };
+	std::unique_ptr<program_t> program = parser.parse();
+
+	optimizer_t optimizer{};
+	optimizer.optimize(*program);
+
+	resolver_t resolver{};
+	resolver.resolve(*program);
+
+	if (program->statements.size() != 1 || program->statements[0]->type != STMT_FUNCTION)
+		return {};
+
+	const script_function_t& tree = *static_cast<const function_stmt_t&>(*program->statements[0]).function;
+	compiler_t compiler{};
+	std::unique_ptr<chunk_t> chunk = compiler.compile(tree);
+
+	auto same = [](const value_t& a, const value_t& b)
+	{
+		if (a.type != b.type)
+			return false;
+
+		if (a.type == RUNTIME_STRING)
+			return a.as_string().text() == b.as_string().text();
+
+		if (a.type == RUNTIME_NUMBER)
+			return std::memcmp(&a.number, &b.number, sizeof(float)) == 0;
+
+		return a.integer == b.integer;
+	};
+
+	if (tree.locals != function.locals || chunk->code != function.chunk->code
+		|| !std::equal(chunk->constants.begin(), chunk->constants.end(), function.chunk->constants.begin(), function.chunk->constants.end(), same))
+		return {};
+
+	return program;
+}
+
+std::shared_ptr<const jit_code_t> jit::compile(const script_function_t& function)
+{
+#ifdef JIT_X64
+	std::unique_ptr<program_t> program{};
+	const script_function_t* tree = &function;
+	if (function.source && function.body.empty())
+	{
+		program = parse_again(function);
+		if (!program)
+			return {};
+
+		tree = static_cast<const function_stmt_t&>(*program->statements[0]).function.get();
+	}
+
+	if (!is_supported(*tree))
+		return {};
+
+	jit_compiler_t compiler{};
+	return compiler.compile(*tree);
+#else
+	return {};
+#endif
+}
+
+const jit_code_t* jit::hot_code(const script_function_t& function)
+{
+	if (!enabled)
+		return nullptr;
+
+	if (function.calls.load(std::memory_order_relaxed) < hot_calls)
+	{
+		function.calls.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	// Every thread waits for the first one to finish compiling, after that this is one atomic load
+	std::call_once(function.native_once, [&function]()
+	{
+		try
+		{
+			function.native = compile(function);
+		}
+		catch (std::exception& err)
+		{
+			std::printf("%s Running %s in the VM.\n", err.what(), function.name.c_str());
+		}
+	});
+
+	return function.native.get();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "../parser/parser.hpp"
+#include "../interpreter/include/basetypes.hpp"
+
+// Baseline JIT: script functions that only do integer math on their own locals (no globals, calls, strings or floats) are turned into x86-64
+// machine code once the VM has called them hot_calls times. Such a function has no side effects, so anything the machine code can't handle
+// (dividing by zero, a non integer argument) just runs the whole call again in the VM, which then does exactly what it always did.
+// Only x86-64 builds have it, everywhere else compile gives back null and the VM runs everything.
+#if defined(_M_X64) || defined(__x86_64__)
+#define JIT_X64
+#endif
+
+enum jit_status_t : std::int32_t
+{
+	JIT_INTEGER,	// *result holds the return value
+	JIT_VOID,		// returned nothing
+	JIT_BAIL		// the VM has to run the call
+};
+
+// Checked by the machine code every loop iteration, running out of fuel or being cancelled bails (the VM then throws like it always does)
+struct jit_limits_t
+{
+	std::int64_t fuel = INT64_MAX;					// loop iterations left
+	const std::atomic<bool>* cancelled = nullptr;	// never null, point it at a false when nothing can cancel
+};
+
+using jit_entry_t = jit_status_t(*)(std::int64_t* locals, std::int64_t* result, jit_limits_t* limits);
+
+// Executable memory holding one function, freed with it.
+class jit_code_t
+{
+private:
+	void* memory = nullptr;
+	std::size_t size = 0;
+	jit_entry_t entry = nullptr;
+public:
+	jit_code_t(const std::vector<std::uint8_t>& code); // throws when the memory can't be made executable
+	jit_code_t(const jit_code_t&) = delete;
+	~jit_code_t();
+
+	// Runs a call with the arguments the VM has on its stack, false when the VM has to run it instead.
+	bool run(const value_t* arguments, std::size_t count, value_t& result, jit_limits_t& limits) const;
+};
+
+namespace jit
+{
+	constexpr std::uint32_t hot_calls = 16;		// VM calls before a function is compiled
+	constexpr std::uint32_t max_locals = 64;	// more than this runs in the VM, run() keeps the locals in a fixed array
+	inline std::atomic<bool> enabled = true;	// --script-bench turns it off to compare
+#ifdef JIT_X64
+	constexpr bool available = true;
+#else
+	constexpr bool available = false;
+#endif
+
+	bool is_supported(const script_function_t& function);
+	std::shared_ptr<const jit_code_t> compile(const script_function_t& function); // null when it isn't supported (or this isn't an x86-64 build)
+
+	// Counts a VM call, compiles the function the first time it gets hot. Null while it's cold or when it can't be compiled.
+	const jit_code_t* hot_code(const script_function_t& function);
+}
@@ -1,165 +1,198 @@
+#include <array>
+#include <stdexcept>
+
 #include "lexer.hpp"
 
-std::vector<token_t>& lexer_t::tokenize()
+enum character_class_t : std::uint8_t
+{
+	CHAR_SPACE = 1 << 0,
+	CHAR_DIGIT = 1 << 1,
+	CHAR_HEX = 1 << 2,			// 0-9 a-f A-F
+	CHAR_IDENTIFIER = 1 << 3	// a-z A-Z 0-9 _ (names can't start with a digit, those are numbers)
+};
+
+// One lookup per character instead of the <cctype> calls, which also don't like negative chars
+static constexpr std::array<std::uint8_t, 256> character_classes = []()
 {
-	std::size_t line_numbers = 0;
+	std::array<std::uint8_t, 256> classes{};
 
-	for (std::size_t index = 0; index < script.size(); index++)
-	{
-		char current = script[index];
+	for (char c : { ' ', '\t', '\n', '\r', '\v', '\f' })
+		classes[static_cast<std::uint8_t>(c)] |= CHAR_SPACE;
 
-		if (isspace(current))
-			continue;
+	for (int c = '0'; c <= '9'; ++c)
+		classes[c] |= CHAR_DIGIT | CHAR_HEX | CHAR_IDENTIFIER;
 
-		if (current == '"')
+	for (int c = 'a'; c <= 'z'; ++c)
+	{
+		classes[c] |= CHAR_IDENTIFIER;
+		classes[c - 'a' + 'A'] |= CHAR_IDENTIFIER;
+		if (c <= 'f')
 		{
-			std::string temp{};
-			while (true)
-			{
-				if (++index < script.size())
-				{
-					current = script[index];
+			classes[c] |= CHAR_HEX;
+			classes[c - 'a' + 'A'] |= CHAR_HEX;
+		}
+	}
 
-					if (current == '"')
-						break;
+	classes['_'] |= CHAR_IDENTIFIER;
 
-					temp.push_back(current);
-				}
-				else
-					throw std::exception("Failed to terminate string literal.");
-			}
+	return classes;
+}();
 
-			tokens.emplace_back(TOK_STRING, temp);
-			continue;
-		}
+// Tokens made of one character, TOK_NONE for anything else
+static constexpr std::array<token_def_t, 256> single_tokens = []()
+{
+	std::array<token_def_t, 256> tokens{};
+	tokens.fill(TOK_NONE);
 
-		if (isdigit(current))
-		{
-			std::string temp{};
-			if (current == '0' && tolower(script[index + 1]) == 'x') // hexadecimal notation?
-			{
-				temp.push_back(current);
-				temp.push_back(script[++index]);
+	for (char c : { '+', '-', '*', '/', '^', '%', '&', '|', '~', '=', '<', '>' })
+		tokens[static_cast<std::uint8_t>(c)] = TOK_BINOP;
 
-				++index;
+	tokens['!'] = TOK_PREFIX;
+	tokens['('] = TOK_LPAREN;
+	tokens[')'] = TOK_RPAREN;
+	tokens['{'] = TOK_CTXBEGIN;
+	tokens['}'] = TOK_CTXEND;
+	tokens[','] = TOK_COMMA;
+	tokens[';'] = TOK_ENDLINE;
 
-				// It's a hex string so it must be tokenized differently than decimal]
-				while (isdigit(current = script[index++]) || tolower(current) == 'a' || tolower(current) == 'b' || tolower(current) == 'c' || tolower(current) == 'd' || tolower(current) == 'e' || tolower(current) == 'f')
-					temp.push_back(current);
+	return tokens;
+}();
 
-				index -= 2;
-			}
-			else 
-			{ // Just a decimal string
-				while (isdigit(current = script[index++]) || current == '.')
-					temp.push_back(current);
+static bool is(char character, std::uint8_t character_class)
+{
+	return character_classes[static_cast<std::uint8_t>(character)] & character_class;
+}
 
-				index -= 2;
-			}
+static token_def_t word_type(std::string_view word)
+{
+	if (word == "void" || word == "bool" || word == "string" || word == "int" || word == "float" || word == "double")
+		return TOK_TYPE;
+
+	if (word == "if" || word == "else" || word == "while" || word == "for" || word == "function" || word == "return" || word == "break" || word == "continue")
+		return TOK_KEYWORD;
+
+	return TOK_IDENTIFIER;
+}
+
+bool lexer_t::next_token(std::string_view script, std::size_t& index, token_t& token)
+{
+	const std::size_t size = script.size();
+
+	auto make = [&token](token_def_t type, std::size_t start, std::size_t end)
+	{
+		token = { type, static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(end - start) };
+		return true;
+	};
 
-			tokens.emplace_back(TOK_NUMBER, temp);
+	while (index < size)
+	{
+		char current = script[index];
+		std::size_t start = index;
+
+		if (is(current, CHAR_SPACE))
+		{
+			++index;
 			continue;
 		}
 
-		if (isalnum(current))
+		if (current == '"')
 		{
-			std::string temp{};
-			while (isalnum(current = script[index++]))
-				temp.push_back(current);
+			std::size_t end = script.find('"', start + 1);
+			if (end == std::string_view::npos)
+				throw std::runtime_error("Failed to terminate string literal.");
 
-			index -= 2;
+			index = end + 1;
+			return make(TOK_STRING, start + 1, end);
+		}
 
-			if (temp == "void" || temp == "bool" || temp == "string" || temp == "int" || temp == "float" || temp == "double")
+		if (is(current, CHAR_DIGIT))
+		{
+			if (current == '0' && index + 1 < size && (script[index + 1] == 'x' || script[index + 1] == 'X')) // hexadecimal notation?
+			{
+				for (index += 2; index < size && is(script[index], CHAR_HEX); ++index);
+			}
+			else // Just a decimal string
 			{
-				tokens.emplace_back(TOK_TYPE, temp);
-				continue;
+				for (; index < size && (is(script[index], CHAR_DIGIT) || script[index] == '.'); ++index);
 			}
 
-			tokens.emplace_back(TOK_IDENTIFIER, temp);
-			continue;
+			return make(TOK_NUMBER, start, index);
 		}
 
-		if (current == '+' && script[index + 1] == '+')
+		if (is(current, CHAR_IDENTIFIER))
 		{
-			++index;
-			tokens.emplace_back(TOK_INCREMENT, "++");
-			continue;
+			for (++index; index < size && is(script[index], CHAR_IDENTIFIER); ++index);
+
+			return make(word_type(script.substr(start, index - start)), start, index);
 		}
-		else if (current == '-' && script[index + 1] == '-')
+
+		char next = index + 1 < size ? script[index + 1] : '\0';
+
+		if (current == '+' && next == '+')
 		{
-			++index;
-			tokens.emplace_back(TOK_DECREMENT, "--");
-			continue;
+			index += 2;
+			return make(TOK_INCREMENT, start, index);
+		}
+		else if (current == '-' && next == '-')
+		{
+			index += 2;
+			return make(TOK_DECREMENT, start, index);
 		}
 
-		switch (current)
+		// Two character operators: << >> == != <= >= && ||
+		if (((current == '<' || current == '>' || current == '&' || current == '|') && next == current) || ((current == '=' || current == '!' || current == '<' || current == '>') && next == '='))
 		{
-			case '+':
-			case '-':
-			case '*':
-			case '/':
-			case '^':
-			case '%':
-			case '=':
-				tokens.emplace_back(TOK_BINOP, current);
-				break;
-			case '!':
-				tokens.emplace_back(TOK_PREFIX, current);
-				break;
-			case '(':
-				tokens.emplace_back(TOK_LPAREN, current);
-				break;
-			case ')':
-				tokens.emplace_back(TOK_RPAREN, current);
-				break;
-			case '{':
-				tokens.emplace_back(TOK_CTXBEGIN, current);
-				break;
-			case '}':
-				tokens.emplace_back(TOK_CTXEND, current);
-				break;
-			case ',':
-				tokens.emplace_back(TOK_COMMA, current);
-				break;
-			case ';':
-			{
-				std::string temp = std::to_string(++line_numbers);
-				tokens.emplace_back(TOK_ENDLINE, temp);
-				break;
-			}
-			default:
-				// tokens.emplace_back(TOK_NONE, current);
-				break;
+			index += 2;
+			return make(TOK_BINOP, start, index);
 		}
 
+		++index;
+
+		token_def_t type = single_tokens[static_cast<std::uint8_t>(current)];
+		if (type != TOK_NONE)
+			return make(type, start, index);
+		// anything else is skipped
 	}
 
-	script.clear();	// No point in holding script anymore
+	return false;
+}
 
-	tokens.emplace_back(TOK_EOF);
+void lexer_t::tokenize()
+{
+	if (script.size() > UINT32_MAX)
+		throw std::runtime_error("Script is too big!");
 
-	return tokens;
+	tokens.clear();
+	tokens.reserve(script.size() / 4 + 1); // roughly, so big scripts don't regrow the vector over and over
+	current_token_index = 0;
+
+	std::size_t index = 0;
+	token_t token{};
+	while (next_token(script, index, token))
+		tokens.push_back(token);
+
+	tokens.push_back({ TOK_EOF, static_cast<std::uint32_t>(script.size()), 0 });
 }
 
 // functions used for reading output
 
 // Consumes the current token and returns it
-token_t lexer_t::consume()
+const token_t& lexer_t::consume()
 {
-	token_t previous = current();
+	const token_t& previous = current();
 	current_token_index = current_token_index + 1 >= tokens.size() ? current_token_index : current_token_index + 1;
 
 	return previous;
 }
 
 // Retrieves the current token
-token_t lexer_t::current()
+const token_t& lexer_t::current() const
 {
 	return tokens[current_token_index];
 }
 
 // Checks if lexer is finished
-bool lexer_t::is_done()
+bool lexer_t::is_done() const
 {
 	return current().type == TOK_EOF;
 }
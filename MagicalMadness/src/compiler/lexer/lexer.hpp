@@ -1,7 +1,9 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <cstdio>
 
 
 enum token_def_t : std::int8_t
@@ -22,42 +24,55 @@ enum token_def_t : std::int8_t
 	TOK_INCREMENT,	// increment (++)
 	TOK_DECREMENT,  // decrement (--)
 	TOK_NUMBER,
-	TOK_STRING
+	TOK_STRING,		// text is what's between the quotes
+	TOK_KEYWORD		// if, else, while, for, function, return, break, continue
 };
 
+// Only where the token is in the script, lexer_t::text gives its characters. Nothing is copied out of the script while lexing.
 class token_t
 {
 public:
-	std::string str{};
 	token_def_t type = TOK_NONE;
-
-	token_t(token_def_t type) : type{ type } {}
-	token_t(token_def_t type, const std::string& str) : type{ type }, str{ str } {}
-	token_t(token_def_t type, char character) : type{ type }
-	{
-		str.push_back(character);
-	}
-
-	void dump()
-	{
-		std::printf("%s | %d\n", str.c_str(), type);
-	}
+	std::uint32_t offset = 0;
+	std::uint32_t length = 0;
 };
 
 
+// The script has to outlive the lexer (and the parser using it), tokens point into it.
 class lexer_t
 {
 private:
-	std::string script{};
+	std::string_view script{};
+	std::vector<token_t> tokens{};
+	std::size_t current_token_index = 0;
 public:
-	lexer_t(const std::string& script) : script{ script } {};
+	lexer_t(std::string_view script) : script{ script } {};
 	lexer_t(const lexer_t&) = delete; // don't want copies.
 
-	std::vector<token_t> tokens{};
-	std::vector<token_t>& tokenize();
+	void tokenize(); // throws on unterminated strings
 
-	std::size_t current_token_index = 0;
-	token_t consume();
-	token_t current();
-	bool is_done();
-};
\ No newline at end of file
+	// The token at or after index (whitespace and unknown characters are skipped), false once the script ends. index ends up right after it.
+	static bool next_token(std::string_view script, std::size_t& index, token_t& token);
+
+	const token_t& consume();	// returns the current token and moves past it (stays on TOK_EOF)
+	const token_t& current() const;
+	bool is_done() const;
+
+	// For incremental_parser_t, it keeps the tokens between edits and only relexes what changed
+	std::vector<token_t>& get_tokens() { return tokens; }
+	const std::vector<token_t>& get_tokens() const { return tokens; }
+	void set_script(std::string_view value) { script = value; }
+	void seek(std::size_t index) { current_token_index = index; }
+	std::size_t position() const { return current_token_index; }
+
+	std::string_view text(const token_t& token) const
+	{
+		return script.substr(token.offset, token.length);
+	}
+
+	void dump() const
+	{
+		for (const token_t& token : tokens)
+			std::printf("%.*s | %d\n", static_cast<int>(token.length), script.data() + token.offset, token.type);
+	}
+};
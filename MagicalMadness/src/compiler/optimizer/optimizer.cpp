@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "optimizer.hpp"
+#include "../interpreter/include/operations.hpp"
+
+static bool is_constant(const stmt_t& node)
+{
+	return node.type == EXPR_PRIMARY && static_cast<const primary_expr_t&>(node).type != PRIMARY_IDENTIFIER;
+}
+
+static value_t constant_value(const stmt_t& node)
+{
+	const primary_expr_t& primary = static_cast<const primary_expr_t&>(node);
+	switch (primary.type)
+	{
+		case PRIMARY_NUMBER:
+			return static_cast<const number_expr_t&>(primary).value;
+		case PRIMARY_INTEGER:
+			return static_cast<const integer_expr_t&>(primary).value;
+		case PRIMARY_STRING:
+			return value_t::make<runtime_string_t>(static_cast<const string_expr_t&>(primary).value);
+		default:
+			throw std::runtime_error("[Optimizer] Not a constant!");
+	}
+}
+
+// null when the value has no literal (void, functions)
+static ast_ptr_t<stmt_t> make_constant(ast_arena_t& arena, const value_t& value)
+{
+	switch (value.type)
+	{
+		case RUNTIME_NUMBER:
+			return arena.make<number_expr_t>(value.number);
+		case RUNTIME_INTEGER:
+			return arena.make<integer_expr_t>(value.integer);
+		case RUNTIME_STRING:
+			return arena.make<string_expr_t>(value.as_string().text());
+		default:
+			return {};
+	}
+}
+
+// Can only give back a value, dropping it when the value isn't used changes nothing. Operators that can throw (binary ones) don't count.
+static bool is_pure(const stmt_t& node)
+{
+	switch (node.type)
+	{
+		case EXPR_PRIMARY:
+			return true;
+		case EXPR_UNARY:
+			return is_pure(*static_cast<const unary_expr_t&>(node).child);
+		case EXPR_NEGATE:
+			return is_pure(*static_cast<const negate_expr_t&>(node).child);
+		case EXPR_COMPLEMENT:
+			return is_pure(*static_cast<const complement_expr_t&>(node).child);
+		case EXPR_LOGICAL:
+		{
+			std::vector<const stmt_t*> chain = left_chain(node);
+			return is_pure(*static_cast<const logical_expr_t*>(chain.front())->left)
+				&& std::all_of(chain.begin(), chain.end(), [](const stmt_t* link) { return is_pure(*static_cast<const logical_expr_t*>(link)->right); });
+		}
+		default:
+			return false;
+	}
+}
+
+static const identifier_expr_t* assigned_identifier(const stmt_t& variable)
+{
+	if (variable.type != EXPR_PRIMARY || static_cast<const primary_expr_t&>(variable).type != PRIMARY_IDENTIFIER)
+		return nullptr;
+
+	return &static_cast<const identifier_expr_t&>(variable);
+}
+
+void optimizer_t::count_assignments(const stmt_t& node)
+{
+	switch (node.type)
+	{
+		case STMT_ASSIGNMENT:
+		{
+			const assignment_stmt_t& assignment = static_cast<const assignment_stmt_t&>(node);
+			if (const identifier_expr_t* identifier = assigned_identifier(*assignment.variable))
+				++assignments[identifier->variable_name];
+
+			count_assignments(*assignment.assignment);
+			break;
+		}
+		case STMT_CALL:
+		{
+			const call_stmt_t& call = static_cast<const call_stmt_t&>(node);
+			count_assignments(*call.function);
+			for (const ast_ptr_t<stmt_t>& argument : call.arguments)
+				count_assignments(*argument);
+			break;
+		}
+		case STMT_BLOCK:
+		{
+			for (const ast_ptr_t<stmt_t>& statement : static_cast<const block_stmt_t&>(node).statements)
+				count_assignments(*statement);
+			break;
+		}
+		case STMT_IF:
+		{
+			std::vector<const if_stmt_t*> chain = if_chain(static_cast<const if_stmt_t&>(node)); // else if chains in a loop
+			for (const if_stmt_t* branch : chain)
+			{
+				count_assignments(*branch->condition);
+				count_assignments(*branch->then_branch);
+			}
+			if (chain.back()->else_branch)
+				count_assignments(*chain.back()->else_branch);
+			break;
+		}
+		case STMT_WHILE:
+		{
+			const while_stmt_t& loop = static_cast<const while_stmt_t&>(node);
+			count_assignments(*loop.condition);
+			count_assignments(*loop.body);
+			break;
+		}
+		case STMT_FOR:
+		{
+			const for_stmt_t& loop = static_cast<const for_stmt_t&>(node);
+			for (const ast_ptr_t<stmt_t>* part : { &loop.initializer, &loop.condition, &loop.step, &loop.body })
+			{
+				if (*part)
+					count_assignments(**part);
+			}
+			break;
+		}
+		case STMT_FUNCTION:
+		{
+			// The body only assigns locals
+			if (const identifier_expr_t* identifier = assigned_identifier(*static_cast<const function_stmt_t&>(node).variable))
+				++assignments[identifier->variable_name];
+			break;
+		}
+		case STMT_RETURN:
+		{
+			const return_stmt_t& return_statement = static_cast<const return_stmt_t&>(node);
+			if (return_statement.value)
+				count_assignments(*return_statement.value);
+			break;
+		}
+		case EXPR_BINARY:
+		{
+			std::vector<const stmt_t*> chain = left_chain(node); // long chains in a loop
+			count_assignments(*static_cast<const binary_expr_t*>(chain.front())->left);
+			for (const stmt_t* link : chain)
+				count_assignments(*static_cast<const binary_expr_t*>(link)->right);
+			break;
+		}
+		case EXPR_LOGICAL:
+		{
+			std::vector<const stmt_t*> chain = left_chain(node);
+			count_assignments(*static_cast<const logical_expr_t*>(chain.front())->left);
+			for (const stmt_t* link : chain)
+				count_assignments(*static_cast<const logical_expr_t*>(link)->right);
+			break;
+		}
+		case EXPR_UNARY:
+			count_assignments(*static_cast<const unary_expr_t&>(node).child);
+			break;
+		case EXPR_NEGATE:
+			count_assignments(*static_cast<const negate_expr_t&>(node).child);
+			break;
+		case EXPR_COMPLEMENT:
+			count_assignments(*static_cast<const complement_expr_t&>(node).child);
+			break;
+		default:
+			break;
+	}
+}
+
+void optimizer_t::optimize_expression(ast_ptr_t<stmt_t>& node)
+{
+	switch (node->type)
+	{
+		case STMT_ASSIGNMENT:
+			optimize_expression(static_cast<assignment_stmt_t&>(*node).assignment); // not the variable, it's written to
+			break;
+		case STMT_CALL:
+		{
+			call_stmt_t& call = static_cast<call_stmt_t&>(*node);
+			optimize_expression(call.function);
+			for (ast_ptr_t<stmt_t>& argument : call.arguments)
+				optimize_expression(argument);
+			break;
+		}
+		case EXPR_BINARY:
+		{
+			// Innermost first like the recursion would, folding a link makes the next one's left a constant
+			std::vector<ast_ptr_t<stmt_t>*> chain = left_chain_slots(node);
+			optimize_expression(static_cast<binary_expr_t&>(**chain.front()).left);
+
+			for (ast_ptr_t<stmt_t>* link : chain)
+			{
+				binary_expr_t& binary = static_cast<binary_expr_t&>(**link);
+				optimize_expression(binary.right);
+
+				if (!is_constant(*binary.left) || !is_constant(*binary.right))
+					continue;
+
+				try
+				{
+					if (ast_ptr_t<stmt_t> folded = make_constant(*arena, interpreter::arithmetic(binary.operand, constant_value(*binary.left), constant_value(*binary.right))))
+						*link = std::move(folded);
+				}
+				catch (std::exception&)
+				{
+					// 1 / 0, "a" - 1 etc. Left alone so running it reports the error where it always did
+				}
+			}
+			break;
+		}
+		case EXPR_LOGICAL:
+		{
+			std::vector<ast_ptr_t<stmt_t>*> chain = left_chain_slots(node);
+			optimize_expression(static_cast<logical_expr_t&>(**chain.front()).left);
+
+			for (ast_ptr_t<stmt_t>* link : chain)
+			{
+				logical_expr_t& logical = static_cast<logical_expr_t&>(**link);
+				optimize_expression(logical.right);
+
+				if (!is_constant(*logical.left))
+					continue;
+
+				// false && x -> false, true && x -> x (same for || the other way around)
+				if (interpreter::is_truthy(constant_value(*logical.left)) != logical.is_and)
+					*link = std::move(logical.left);
+				else
+					*link = std::move(logical.right);
+			}
+			break;
+		}
+		case EXPR_UNARY:
+		case EXPR_NEGATE:
+		case EXPR_COMPLEMENT:
+		{
+			// All three have the same layout, only the operation differs
+			ast_ptr_t<stmt_t>& child = node->type == EXPR_UNARY ? static_cast<unary_expr_t&>(*node).child : node->type == EXPR_NEGATE ? static_cast<negate_expr_t&>(*node).child : static_cast<complement_expr_t&>(*node).child;
+			optimize_expression(child);
+
+			if (!is_constant(*child))
+				break;
+
+			value_t value = constant_value(*child);
+			value_t result = node->type == EXPR_UNARY ? interpreter::logical_not(value) : node->type == EXPR_NEGATE ? interpreter::negate(value) : interpreter::complement(value);
+			if (ast_ptr_t<stmt_t> folded = make_constant(*arena, result))
+				node = std::move(folded);
+			break;
+		}
+		case EXPR_PRIMARY:
+		{
+			primary_expr_t& primary = static_cast<primary_expr_t&>(*node);
+			if (primary.type != PRIMARY_IDENTIFIER || in_function)
+				break;
+
+			auto found = constants.find(static_cast<identifier_expr_t&>(primary).variable_name);
+			if (found != constants.end())
+				node = make_constant(*arena, found->second);
+			break;
+		}
+		default:
+			throw std::runtime_error("[Optimizer] Unexpected expression: " + std::to_string(node->type));
+	}
+}
+
+// Branches can't be null, an empty block stands in for a removed one
+void optimizer_t::optimize_branch(ast_ptr_t<stmt_t>& branch)
+{
+	optimize_statement(branch, false);
+	if (!branch)
+		branch = arena->make<block_stmt_t>();
+}
+
+// Sets statement to null when it can be removed
+void optimizer_t::optimize_statement(ast_ptr_t<stmt_t>& statement, bool top_level)
+{
+	switch (statement->type)
+	{
+		case STMT_BLOCK:
+		{
+			block_stmt_t& block = static_cast<block_stmt_t&>(*statement);
+			optimize_block(block.statements, false);
+			if (block.statements.empty())
+				statement = nullptr;
+			break;
+		}
+		case STMT_IF:
+		{
+			// else if chains in a loop, link is where the if being looked at is held (the statement or the else branch of the one before)
+			ast_ptr_t<stmt_t>* link = &statement;
+			bool link_top_level = top_level;
+			while (true)
+			{
+				if_stmt_t& branch = static_cast<if_stmt_t&>(**link);
+				optimize_expression(branch.condition);
+
+				if (is_constant(*branch.condition))
+				{
+					bool truthy = interpreter::is_truthy(constant_value(*branch.condition));
+					ast_ptr_t<stmt_t> taken = std::move(truthy ? branch.then_branch : branch.else_branch);
+
+					// An if that's never taken is replaced by the rest of the chain, which is looked at next
+					if (!truthy && taken && taken->type == STMT_IF)
+					{
+						*link = std::move(taken);
+						continue;
+					}
+
+					if (!taken)
+					{
+						*link = nullptr;
+						break;
+					}
+
+					// Kept in a block, a statement moved to the top level would start printing its result
+					ast_ptr_t<block_stmt_t> block = arena->make<block_stmt_t>();
+					block->statements.push_back(std::move(taken));
+					*link = std::move(block);
+					optimize_statement(*link, link_top_level);
+					break;
+				}
+
+				optimize_branch(branch.then_branch);
+				if (!branch.else_branch)
+					break;
+
+				if (branch.else_branch->type != STMT_IF)
+				{
+					optimize_statement(branch.else_branch, false);
+					break;
+				}
+
+				link = &branch.else_branch;
+				link_top_level = false;
+			}
+			break;
+		}
+		case STMT_WHILE:
+		{
+			while_stmt_t& loop = static_cast<while_stmt_t&>(*statement);
+			optimize_expression(loop.condition);
+
+			if (is_constant(*loop.condition) && !interpreter::is_truthy(constant_value(*loop.condition)))
+			{
+				statement = nullptr;
+				break;
+			}
+
+			optimize_branch(loop.body);
+			break;
+		}
+		case STMT_FOR:
+		{
+			for_stmt_t& loop = static_cast<for_stmt_t&>(*statement);
+			if (loop.initializer)
+				optimize_expression(loop.initializer);
+			if (loop.condition)
+				optimize_expression(loop.condition);
+			if (loop.step)
+				optimize_expression(loop.step);
+
+			if (loop.condition && is_constant(*loop.condition))
+			{
+				if (!interpreter::is_truthy(constant_value(*loop.condition)))
+				{
+					// Only the initializer ever runs
+					ast_ptr_t<block_stmt_t> block = arena->make<block_stmt_t>();
+					if (loop.initializer)
+						block->statements.push_back(std::move(loop.initializer));
+					statement = std::move(block);
+					optimize_statement(statement, top_level);
+					break;
+				}
+
+				loop.condition = nullptr; // always true, same as leaving it out
+			}
+
+			optimize_branch(loop.body);
+			break;
+		}
+		case STMT_FUNCTION:
+		{
+			script_function_t& function = *static_cast<function_stmt_t&>(*statement).function;
+			ast_arena_t* outer = arena;
+
+			in_function = true;
+			arena = &function.arena;
+			optimize_block(function.body, false);
+			arena = outer;
+			in_function = false;
+			break;
+		}
+		case STMT_RETURN:
+		{
+			return_stmt_t& return_statement = static_cast<return_stmt_t&>(*statement);
+			if (return_statement.value)
+				optimize_expression(return_statement.value);
+			break;
+		}
+		case STMT_BREAK:
+		case STMT_CONTINUE:
+			break;
+		default:
+		{
+			optimize_expression(statement);
+
+			// Top level statements print their result, that's someone looking at it
+			if (!top_level && is_pure(*statement))
+			{
+				statement = nullptr;
+				break;
+			}
+
+			// x = constant; at the top level always runs before the code after it, if nothing else assigns x that code can use the constant
+			if (top_level && !in_function && statement->type == STMT_ASSIGNMENT)
+			{
+				assignment_stmt_t& assignment = static_cast<assignment_stmt_t&>(*statement);
+				const identifier_expr_t* identifier = assigned_identifier(*assignment.variable);
+				if (identifier && is_constant(*assignment.assignment) && assignments[identifier->variable_name] == 1)
+					constants.insert_or_assign(identifier->variable_name, constant_value(*assignment.assignment));
+			}
+			break;
+		}
+	}
+}
+
+void optimizer_t::optimize_block(std::vector<ast_ptr_t<stmt_t>>& statements, bool top_level)
+{
+	for (std::size_t i = 0; i < statements.size(); ++i)
+	{
+		stmt_types_t type = statements[i]->type;
+		optimize_statement(statements[i], top_level);
+
+		// Nothing after these runs
+		if (type == STMT_RETURN || type == STMT_BREAK || type == STMT_CONTINUE)
+		{
+			statements.resize(i + 1);
+			break;
+		}
+	}
+
+	std::erase_if(statements, [](const ast_ptr_t<stmt_t>& statement) { return !statement; });
+}
+
+void optimizer_t::optimize(program_t& program)
+{
+	assignments.clear();
+	constants.clear();
+	in_function = false;
+	arena = &program.arena;
+
+	for (const ast_ptr_t<stmt_t>& statement : program.statements)
+		count_assignments(*statement);
+
+	optimize_block(program.statements, true);
+}
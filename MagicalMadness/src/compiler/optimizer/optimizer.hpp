@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+
+#include "../parser/parser.hpp"
+#include "../interpreter/include/basetypes.hpp"
+
+// Runs between parsing and resolver_t, rewrites the tree so every run (VM or tree walker) does less:
+//	- folds operators on constants (1 + 2 * 3 -> 7), using the same operations as the runtime so results & errors can't differ
+//	- replaces globals assigned once, unconditionally, to a constant with that constant (in the top level code after the assignment)
+//	- drops branches & loops with constant conditions, pure expression statements nobody sees the result of and code after return/break/continue
+class optimizer_t
+{
+private:
+	std::unordered_map<std::string, std::size_t> assignments{};	// Global -> times it's assigned (outside functions, inside them makes locals)
+	std::unordered_map<std::string, value_t> constants{};		// Globals known to hold a constant from here on
+	bool in_function = false;									// Function bodies can run before the assignment (or after a later one), nothing is propagated in there
+	ast_arena_t* arena = nullptr;								// New nodes go where the code being optimized lives
+
+	void count_assignments(const stmt_t& node);
+
+	void optimize_expression(ast_ptr_t<stmt_t>& node);
+	void optimize_branch(ast_ptr_t<stmt_t>& branch);
+	void optimize_statement(ast_ptr_t<stmt_t>& statement, bool top_level);
+	void optimize_block(std::vector<ast_ptr_t<stmt_t>>& statements, bool top_level);
+public:
+	optimizer_t() = default;
+	optimizer_t(const optimizer_t&) = delete;
+
+	void optimize(program_t& program);
+};
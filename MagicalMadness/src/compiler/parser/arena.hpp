@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Tree nodes don't free themselves, the arena they were made in does it all at once when it goes away.
+// Still a unique_ptr so the tree keeps saying who owns what, moving nodes around works the same.
+struct ast_release_t
+{
+	template <class T>
+	void operator()(T*) const {}
+};
+
+template <class T>
+using ast_ptr_t = std::unique_ptr<T, ast_release_t>;
+
+// Bump allocator for the syntax tree: parsing a script is one allocation per block instead of one per node.
+// Nodes that own something (strings, vectors) get their destructor run when the arena dies, newest first, then the blocks are freed.
+class ast_arena_t
+{
+private:
+	static constexpr std::size_t block_size = 16 * 1024;
+
+	struct block_t
+	{
+		block_t* next;
+	};
+
+	struct cleanup_t
+	{
+		void (*destroy)(void* object);
+		void* object;
+		cleanup_t* next;
+	};
+
+	block_t* blocks = nullptr;
+	std::uint8_t* cursor = nullptr;
+	std::uint8_t* end = nullptr;
+	cleanup_t* cleanups = nullptr;
+
+	void* allocate(std::size_t size, std::size_t alignment)
+	{
+		std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+		if (!cursor || aligned + size > reinterpret_cast<std::uintptr_t>(end))
+		{
+			std::size_t usable = size + alignment > block_size ? size + alignment : block_size;
+			block_t* block = static_cast<block_t*>(::operator new(sizeof(block_t) + usable));
+			block->next = blocks;
+			blocks = block;
+
+			cursor = reinterpret_cast<std::uint8_t*>(block + 1);
+			end = cursor + usable;
+			aligned = (reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+		}
+
+		cursor = reinterpret_cast<std::uint8_t*>(aligned + size);
+		return reinterpret_cast<void*>(aligned);
+	}
+public:
+	ast_arena_t() = default;
+	ast_arena_t(const ast_arena_t&) = delete; // nodes point into it, it can't move
+
+	~ast_arena_t()
+	{
+		for (cleanup_t* cleanup = cleanups; cleanup; cleanup = cleanup->next)
+			cleanup->destroy(cleanup->object);
+
+		while (blocks)
+		{
+			block_t* next = blocks->next;
+			::operator delete(blocks);
+			blocks = next;
+		}
+	}
+
+	template <class T, class... args_t>
+	ast_ptr_t<T> make(args_t&&... args)
+	{
+		T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<args_t>(args)...);
+
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			cleanups = new (allocate(sizeof(cleanup_t), alignof(cleanup_t))) cleanup_t{ [](void* object) { static_cast<T*>(object)->~T(); }, object, cleanups };
+
+		return ast_ptr_t<T>{ object };
+	}
+};
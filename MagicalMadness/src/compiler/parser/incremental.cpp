@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "incremental.hpp"
+
+// Where a token is in the script, strings include their quotes
+static std::size_t span_start(const token_t& token)
+{
+	return token.type == TOK_STRING ? token.offset - 1 : token.offset;
+}
+
+static std::size_t span_end(const token_t& token)
+{
+	return token.type == TOK_STRING ? token.offset + token.length + 1 : token.offset + token.length;
+}
+
+// After a statement that doesn't parse, skip to the end of it: the next ; or the } closing what it opened
+std::size_t incremental_parser_t::recover(std::size_t first) const
+{
+	const std::vector<token_t>& tokens = lexer.get_tokens();
+
+	std::size_t depth = 0;
+	std::size_t i = first;
+	for (; tokens[i].type != TOK_EOF; ++i)
+	{
+		if (tokens[i].type == TOK_CTXBEGIN)
+			++depth;
+		else if (tokens[i].type == TOK_CTXEND && (depth == 0 || --depth == 0))
+			return i + 1;
+		else if (tokens[i].type == TOK_ENDLINE && depth == 0)
+			return i + 1;
+	}
+
+	return i;
+}
+
+void incremental_parser_t::update(std::string_view text)
+{
+	if (text.size() >= UINT32_MAX)
+		throw std::runtime_error("Script is too big!");
+
+	std::vector<token_t>& tokens = lexer.get_tokens();
+	bool full = tokens.empty() || !lex_error.empty(); // a script that didn't lex has no tokens past the error
+
+	// The edit is whatever is between the common start and the common end
+	std::size_t limit = std::min(source.size(), text.size());
+	std::size_t prefix = std::mismatch(source.begin(), source.begin() + limit, text.begin()).first - source.begin();
+	std::size_t suffix = std::mismatch(source.rbegin(), source.rbegin() + (limit - prefix), text.rbegin()).first - source.rbegin();
+
+	if (!full && prefix == limit && source.size() == text.size())
+	{
+		relexed_tokens = 0;
+		reparsed_statements = 0;
+		return;
+	}
+
+	std::size_t new_end = text.size() - suffix;
+	std::int64_t delta = static_cast<std::int64_t>(text.size()) - static_cast<std::int64_t>(source.size());
+
+	source.assign(text);
+	lexer.set_script(source);
+
+	// Relex from the first token touching the edit (it can grow into it, "ab" + "c") until a token lines up with an old one past the edit
+	std::size_t first = 0;
+	std::size_t start = 0;
+	if (!full)
+	{
+		first = std::partition_point(tokens.begin(), tokens.end(), [prefix](const token_t& token) { return span_end(token) < prefix; }) - tokens.begin();
+		start = std::min(span_start(tokens[first]), prefix);
+	}
+
+	std::vector<token_t> fresh{};
+	std::size_t replaced = tokens.size() - first; // up to the end (and the old EOF) unless it lines up
+	bool synced = false;
+
+	lex_error.clear();
+	std::size_t index = start;
+	try
+	{
+		std::size_t old_token = first;
+		token_t token{};
+		while (!synced && lexer_t::next_token(source, index, token))
+		{
+			if (!full && span_start(token) >= new_end)
+			{
+				std::int64_t old_start = static_cast<std::int64_t>(span_start(token)) - delta;
+				while (old_token + 1 < tokens.size() && static_cast<std::int64_t>(span_start(tokens[old_token])) < old_start)
+					++old_token;
+
+				const token_t& old = tokens[old_token];
+				if (old.type != TOK_EOF && old.type == token.type && old.length == token.length && static_cast<std::int64_t>(span_start(old)) == old_start)
+				{
+					replaced = old_token - first;
+					synced = true;
+					break;
+				}
+			}
+
+			fresh.push_back(token);
+		}
+	}
+	catch (std::exception& err)
+	{
+		// Nothing after an unterminated string is a token, the next edit lexes everything again
+		lex_error = err.what();
+		lex_error_offset = static_cast<std::uint32_t>(index); // left on the opening quote
+		synced = false;
+		replaced = tokens.size() - first;
+	}
+
+	if (!synced)
+		fresh.push_back({ TOK_EOF, static_cast<std::uint32_t>(lex_error.empty() ? source.size() : lex_error_offset), 0 });
+
+	std::size_t changed_end = first + fresh.size();
+	std::int64_t token_delta = static_cast<std::int64_t>(fresh.size()) - static_cast<std::int64_t>(replaced);
+	relexed_tokens = fresh.size();
+
+	for (std::size_t i = first + replaced; i < tokens.size(); ++i)
+		tokens[i].offset = static_cast<std::uint32_t>(tokens[i].offset + delta);
+
+	tokens.erase(tokens.begin() + first, tokens.begin() + first + replaced);
+	tokens.insert(tokens.begin() + first, fresh.begin(), fresh.end());
+
+	// Statements that never looked at the changed tokens keep their parse. The parser looks one token past a statement (for else) and
+	// one that failed can have looked further than where it was skipped to.
+	if (full || !lex_error.empty())
+		statements.clear();
+
+	std::size_t first_statement = std::partition_point(statements.begin(), statements.end(), [first](const statement_t& statement) { return statement.furthest < first; }) - statements.begin();
+	std::size_t start_token = first_statement < statements.size() ? statements[first_statement].first : (statements.empty() ? 0 : statements.back().end);
+
+	std::vector<statement_t> parsed{};
+	std::size_t old_statement = first_statement;
+	std::size_t replaced_statements = statements.size() - first_statement;
+
+	ast_arena_t arena{}; // only checking, the nodes go away with it
+	parser_t parser{ lexer };
+	lexer.seek(start_token);
+
+	while (!lexer.is_done())
+	{
+		std::size_t begin = lexer.position();
+
+		// Past the changed tokens, a statement starting where an old one started parses the same way, so does everything after it
+		if (begin >= changed_end)
+		{
+			std::int64_t old_begin = static_cast<std::int64_t>(begin) - token_delta;
+			while (old_statement < statements.size() && statements[old_statement].first < old_begin)
+				++old_statement;
+
+			if (old_statement < statements.size() && statements[old_statement].first == old_begin)
+			{
+				replaced_statements = old_statement - first_statement;
+				break;
+			}
+		}
+
+		statement_t statement{ static_cast<std::uint32_t>(begin) };
+		try
+		{
+			parser.parse_next(arena);
+		}
+		catch (std::exception& err)
+		{
+			statement.error = err.what();
+			statement.error_offset = lexer.current().offset;
+			statement.reach = static_cast<std::uint32_t>(lexer.position());
+			lexer.seek(recover(begin));
+		}
+
+		statement.end = static_cast<std::uint32_t>(lexer.position());
+		statement.reach = std::max<std::uint32_t>(statement.reach, statement.end);
+		parsed.push_back(std::move(statement));
+	}
+
+	reparsed_statements = parsed.size();
+
+	for (std::size_t i = first_statement + replaced_statements; i < statements.size(); ++i)
+	{
+		statements[i].first = static_cast<std::uint32_t>(statements[i].first + token_delta);
+		statements[i].end = static_cast<std::uint32_t>(statements[i].end + token_delta);
+		statements[i].reach = static_cast<std::uint32_t>(statements[i].reach + token_delta);
+		statements[i].furthest = static_cast<std::uint32_t>(statements[i].furthest + token_delta);
+		statements[i].error_offset = static_cast<std::uint32_t>(statements[i].error_offset + delta);
+	}
+
+	statements.erase(statements.begin() + first_statement, statements.begin() + first_statement + replaced_statements);
+	statements.insert(statements.begin() + first_statement, std::make_move_iterator(parsed.begin()), std::make_move_iterator(parsed.end()));
+
+	// furthest is the most any statement up to this one looked at, it stops changing soon after the reparsed ones
+	for (std::size_t i = first_statement; i < statements.size(); ++i)
+	{
+		std::uint32_t furthest = std::max(statements[i].reach, i ? statements[i - 1].furthest : 0);
+		if (i >= first_statement + parsed.size() && statements[i].furthest == furthest)
+			break;
+
+		statements[i].furthest = furthest;
+	}
+}
+
+std::vector<script_diagnostic_t> incremental_parser_t::diagnostics() const
+{
+	std::vector<script_diagnostic_t> output{};
+
+	auto add = [this, &output](std::uint32_t offset, const std::string& message)
+	{
+		std::uint32_t line = 1 + static_cast<std::uint32_t>(std::count(source.begin(), source.begin() + std::min<std::size_t>(offset, source.size()), '\n'));
+		output.push_back({ offset, line, message });
+	};
+
+	for (const statement_t& statement : statements)
+	{
+		if (!statement.error.empty())
+			add(statement.error_offset, statement.error);
+	}
+
+	if (!lex_error.empty())
+		add(lex_error_offset, lex_error);
+
+	return output;
+}
+
+std::size_t incremental_parser_t::token_count() const
+{
+	return lexer.get_tokens().size();
+}
+
+std::size_t incremental_parser_t::statement_count() const
+{
+	return statements.size();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.hpp"
+
+struct script_diagnostic_t
+{
+	std::uint32_t offset = 0;	// into the script
+	std::uint32_t line = 0;		// 1 based
+	std::string message{};
+};
+
+// Syntax checking for a script that's being edited. The tokens and top level statements are kept between edits, checking again only
+// relexes the tokens around the edit and reparses the statements they're in. Past the edit everything is reused as soon as it lines up
+// with what was there before: the lexer starts over at every token and the parser at every top level statement, so from a shared
+// boundary on the results are the same.
+// Only the syntax is checked (what parser_t throws), the resolver's errors still show up when the script runs.
+class incremental_parser_t
+{
+private:
+	struct statement_t
+	{
+		std::uint32_t first = 0;		// token range
+		std::uint32_t end = 0;
+		std::uint32_t reach = 0;		// last token the parse looked at
+		std::uint32_t furthest = 0;		// highest reach up to here, so it can be searched
+		std::string error{};			// empty when it parsed
+		std::uint32_t error_offset = 0;
+	};
+
+	std::string source{};
+	lexer_t lexer{ std::string_view{} };
+	std::vector<statement_t> statements{};
+	std::string lex_error{};
+	std::uint32_t lex_error_offset = 0;
+
+	std::size_t recover(std::size_t first) const;
+public:
+	std::size_t relexed_tokens = 0;			// by the last update, these stay small for small edits
+	std::size_t reparsed_statements = 0;
+
+	void update(std::string_view text);
+	std::vector<script_diagnostic_t> diagnostics() const;
+	std::size_t token_count() const;
+	std::size_t statement_count() const;
+};
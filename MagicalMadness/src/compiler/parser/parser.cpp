@@ -1,30 +1,66 @@
+#include <charconv>
+#include <stdexcept>
+
 #include "parser.hpp"
 
-std::unique_ptr<stmt_t> parser_t::parse_primary()
+static binary_operator_t to_binary_operator(std::string_view symbol)
+{
+	for (std::size_t i = 0; i < std::size(binary_operator_strings); ++i)
+	{
+		if (binary_operator_strings[i] == symbol)
+			return static_cast<binary_operator_t>(i);
+	}
+
+	throw std::runtime_error("Unknown binary operator: \"" + std::string(symbol) + "\"");
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_primary()
 {
-	token_t current = lexer->consume();
+	const token_t& current = lexer->consume();
+	std::string_view text = lexer->text(current);
 
 	switch (current.type)
 	{
 		case TOK_NUMBER:
 		{
-			float num = strtof(current.str.c_str(), nullptr);
-			std::unique_ptr<number_expr_t> number = std::make_unique<number_expr_t>(num);
+			// The whole token has to be the number and it has to fit ("0x", "1.2.3" and 2^64 don't)
+			auto check = [text](std::from_chars_result result, std::string_view digits)
+			{
+				if (result.ec != std::errc{} || result.ptr != digits.data() + digits.size())
+					throw std::runtime_error("Invalid number literal: \"" + std::string(text) + "\"");
+			};
+
+			// No decimal point means integer, so addresses stay exact.
+			if (text.find('.') == std::string_view::npos)
+			{
+				std::string_view digits = text;
+				bool hex = digits.size() > 1 && (digits[1] == 'x' || digits[1] == 'X');
+				if (hex)
+					digits.remove_prefix(2);
+
+				std::uint64_t integer = 0;
+				check(std::from_chars(digits.data(), digits.data() + digits.size(), integer, hex ? 16 : 10), digits);
+				return arena->make<integer_expr_t>(static_cast<std::int64_t>(integer));
+			}
+
+			float num = 0.f;
+			check(std::from_chars(text.data(), text.data() + text.size(), num), text);
+			ast_ptr_t<number_expr_t> number = arena->make<number_expr_t>(num);
 			return number;
 		}
 		case TOK_STRING:
 		{
-			std::unique_ptr<string_expr_t> string = std::make_unique<string_expr_t>(current.str);
+			ast_ptr_t<string_expr_t> string = arena->make<string_expr_t>(std::string(text));
 			return string;
 		}
 		case TOK_IDENTIFIER:
 		{
-			std::unique_ptr<identifier_expr_t> identifier = std::make_unique<identifier_expr_t>(current.str);
+			ast_ptr_t<identifier_expr_t> identifier = arena->make<identifier_expr_t>(std::string(text));
 			return identifier;
 		}
 		default:
 		{
-			throw std::exception(("Expected identifier when parsing expression, got: \"" + current.str + "\"").c_str());
+			throw std::runtime_error("Expected identifier when parsing expression, got: \"" + std::string(text) + "\"");
 			break;
 		}
 	}
@@ -32,9 +68,9 @@ std::unique_ptr<stmt_t> parser_t::parse_primary()
 	return {};
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_parenthesis()
+ast_ptr_t<stmt_t> parser_t::parse_parenthesis()
 {
-	std::unique_ptr<stmt_t> root;
+	ast_ptr_t<stmt_t> root;
 
 	if (lexer->current().type == TOK_LPAREN)
 	{
@@ -44,7 +80,7 @@ std::unique_ptr<stmt_t> parser_t::parse_parenthesis()
 
 		if (lexer->current().type != TOK_RPAREN)
 		{
-			throw std::exception("Missing closing parenthesis!");
+			throw std::runtime_error("Missing closing parenthesis!");
 		}
 
 		lexer->consume();
@@ -55,15 +91,15 @@ std::unique_ptr<stmt_t> parser_t::parse_parenthesis()
 	return root;
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_call()
+ast_ptr_t<stmt_t> parser_t::parse_call()
 {
-	std::unique_ptr<stmt_t> root = parse_parenthesis();
+	ast_ptr_t<stmt_t> root = parse_parenthesis();
 
 	token_def_t current = lexer->current().type;
 	if (current == TOK_LPAREN)
 	{
 		lexer->consume();
-		std::unique_ptr<call_stmt_t> call_statement = std::make_unique<call_stmt_t>(std::move(root));
+		ast_ptr_t<call_stmt_t> call_statement = arena->make<call_stmt_t>(std::move(root));
 
 		if (lexer->current().type != TOK_RPAREN) // if not zero args
 		{
@@ -78,7 +114,7 @@ std::unique_ptr<stmt_t> parser_t::parse_call()
 
 		if (current != TOK_RPAREN) // check if parenthesis is the end of call
 		{
-			throw std::exception("[CALL] Missing closing parenthesis!");
+			throw std::runtime_error("[CALL] Missing closing parenthesis!");
 		}
 
 		return call_statement;
@@ -87,20 +123,24 @@ std::unique_ptr<stmt_t> parser_t::parse_call()
 	return root;
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_unary_expr()
+ast_ptr_t<stmt_t> parser_t::parse_unary_expr()
 {
-	std::unique_ptr<stmt_t> root;
+	ast_ptr_t<stmt_t> root;
 
-	char current = lexer->current().str[0];
-	if (current == '!')
+	if (is_operator("!"))
 	{
 		lexer->consume();
-		root = std::make_unique<unary_expr_t>(parse_call());
+		root = arena->make<unary_expr_t>(parse_call());
 	}
-	else if (current == '-') // THIS IS WRONG FIX THIS TO WORK WITH ACTUAL TOKENS. (such as --)
+	else if (is_operator("-"))
 	{
 		lexer->consume();
-		root = std::make_unique<negate_expr_t>(parse_call());
+		root = arena->make<negate_expr_t>(parse_call());
+	}
+	else if (is_operator("~"))
+	{
+		lexer->consume();
+		root = arena->make<complement_expr_t>(parse_call());
 	}
 	else
 	{
@@ -111,72 +151,344 @@ std::unique_ptr<stmt_t> parser_t::parse_unary_expr()
 	return root;
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_multiplicative_expr()
+ast_ptr_t<stmt_t> parser_t::parse_multiplicative_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_unary_expr();
+
+	while (is_operator("*") || is_operator("/") || is_operator("%") || is_operator("^"))
+	{
+		binary_operator_t operand = to_binary_operator(lexer->text(lexer->consume()));
+		root = arena->make<binary_expr_t>(operand, std::move(root), parse_unary_expr());
+	}
+
+	return root;
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_additive_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_multiplicative_expr();
+
+	while (is_operator("+") || is_operator("-"))
+	{
+		binary_operator_t operand = to_binary_operator(lexer->text(lexer->consume()));
+		root = arena->make<binary_expr_t>(operand, std::move(root), parse_multiplicative_expr()); // reparent
+	}
+
+	return root;
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_shift_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_additive_expr();
+
+	while (is_operator("<<") || is_operator(">>"))
+	{
+		binary_operator_t operand = to_binary_operator(lexer->text(lexer->consume()));
+		root = arena->make<binary_expr_t>(operand, std::move(root), parse_additive_expr());
+	}
+
+	return root;
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_bitwise_and_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_shift_expr();
+
+	while (is_operator("&"))
+	{
+		lexer->consume();
+		root = arena->make<binary_expr_t>(BINARY_AND, std::move(root), parse_shift_expr());
+	}
+
+	return root;
+}
+
+// Binary ~ is xor (^ is already power), same as Lua.
+ast_ptr_t<stmt_t> parser_t::parse_bitwise_xor_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_bitwise_and_expr();
+
+	while (is_operator("~"))
+	{
+		lexer->consume();
+		root = arena->make<binary_expr_t>(BINARY_XOR, std::move(root), parse_bitwise_and_expr());
+	}
+
+	return root;
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_bitwise_or_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_bitwise_xor_expr();
+
+	while (is_operator("|"))
+	{
+		lexer->consume();
+		root = arena->make<binary_expr_t>(BINARY_OR, std::move(root), parse_bitwise_xor_expr());
+	}
+
+	return root;
+}
+
+// Comparisons share one level below the bitwise operators (like Lua), so (flags & 0x10) == 0 can be written without the parenthesis.
+bool parser_t::is_comparison()
+{
+	return is_operator("==") || is_operator("!=") || is_operator("<") || is_operator("<=") || is_operator(">") || is_operator(">=");
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_comparison_expr()
 {
-	std::unique_ptr<stmt_t> root = parse_unary_expr();
+	ast_ptr_t<stmt_t> root = parse_bitwise_or_expr();
 
-	char current = lexer->current().str[0];
-	while (current == '*' || current == '/' || current == '%' || current == '^')
+	while (is_comparison())
+	{
+		binary_operator_t operand = to_binary_operator(lexer->text(lexer->consume()));
+		root = arena->make<binary_expr_t>(operand, std::move(root), parse_bitwise_or_expr());
+	}
+
+	return root;
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_logical_and_expr()
+{
+	ast_ptr_t<stmt_t> root = parse_comparison_expr();
+
+	while (is_operator("&&"))
 	{
 		lexer->consume();
-		root = std::make_unique<binary_expr_t>(current, std::move(root), parse_unary_expr());
-		current = lexer->current().str[0]; // increment lexer
+		root = arena->make<logical_expr_t>(true, std::move(root), parse_comparison_expr());
 	}
 
 	return root;
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_additive_expr()
+ast_ptr_t<stmt_t> parser_t::parse_logical_or_expr()
 {
-	std::unique_ptr<stmt_t> root = parse_multiplicative_expr();
+	ast_ptr_t<stmt_t> root = parse_logical_and_expr();
 
-	char current = lexer->current().str[0];
-	while (current == '+' || current == '-')
+	while (is_operator("||"))
 	{
 		lexer->consume();
-		root = std::make_unique<binary_expr_t>(current, std::move(root), parse_multiplicative_expr()); // reparent
-		current = lexer->current().str[0]; // increment lexer
+		root = arena->make<logical_expr_t>(false, std::move(root), parse_logical_and_expr());
 	}
 
 	return root;
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_expr()
+ast_ptr_t<stmt_t> parser_t::parse_expr()
 {
-	return parse_additive_expr();
+	nesting_t level{ nesting };
+	return parse_logical_or_expr();
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_assignment()
+ast_ptr_t<stmt_t> parser_t::parse_assignment()
 {
-	std::unique_ptr<stmt_t> root = parse_expr();
+	ast_ptr_t<stmt_t> root = parse_expr();
 
-	char current = lexer->current().str[0];
-	if (current == '=') // No lexer incrementing (looping) because this output result should be a STATEMENT.
+	if (is_operator("=")) // No lexer incrementing (looping) because this output result should be a STATEMENT.
 	{
 		lexer->consume();
-		root = std::make_unique<assignment_stmt_t>(std::move(root), parse_expr());
+		root = arena->make<assignment_stmt_t>(std::move(root), parse_expr());
+	}
+
+	return root;
+}
+
+void parser_t::expect(token_def_t type, const char* error)
+{
+	if (lexer->consume().type != type)
+		throw std::runtime_error(error);
+}
+
+bool parser_t::is_keyword(std::string_view keyword)
+{
+	return lexer->current().type == TOK_KEYWORD && lexer->text(lexer->current()) == keyword;
+}
+
+// Checks the token type too, so a string like "-" isn't taken for the operator
+bool parser_t::is_operator(std::string_view symbol)
+{
+	const token_t& current = lexer->current();
+	return (current.type == TOK_BINOP || current.type == TOK_PREFIX) && lexer->text(current) == symbol;
+}
+
+ast_ptr_t<block_stmt_t> parser_t::parse_block()
+{
+	nesting_t level{ nesting };
+	expect(TOK_CTXBEGIN, "Expected '{'!");
+
+	ast_ptr_t<block_stmt_t> block = arena->make<block_stmt_t>();
+	while (lexer->current().type != TOK_CTXEND)
+	{
+		if (lexer->is_done())
+			throw std::runtime_error("Missing closing brace!");
+
+		block->statements.push_back(parse_statement());
 	}
 
+	lexer->consume();
+	return block;
+}
+
+// else if is just an if statement as the else branch, a chain of them is parsed in this loop so it doesn't count as nesting (see if_chain)
+ast_ptr_t<stmt_t> parser_t::parse_if()
+{
+	ast_ptr_t<stmt_t> root{};
+	ast_ptr_t<stmt_t>* link = &root;
+
+	do
+	{
+		lexer->consume();
+		expect(TOK_LPAREN, "[IF] Expected '(' after if!");
+		ast_ptr_t<stmt_t> condition = parse_expr();
+		expect(TOK_RPAREN, "[IF] Missing closing parenthesis!");
+
+		ast_ptr_t<stmt_t> then_branch = parse_body();
+		*link = arena->make<if_stmt_t>(std::move(condition), std::move(then_branch), nullptr);
+		link = &static_cast<if_stmt_t&>(**link).else_branch;
+
+		if (!is_keyword("else"))
+			return root;
+
+		lexer->consume();
+	} while (is_keyword("if"));
+
+	*link = parse_body();
 	return root;
 }
 
-std::unique_ptr<stmt_t> parser_t::parse_statement()
+// Body of an if, else, while or for, one level deeper with or without braces (parse_block counts those)
+ast_ptr_t<stmt_t> parser_t::parse_body()
+{
+	if (lexer->current().type == TOK_CTXBEGIN)
+		return parse_block();
+
+	nesting_t level{ nesting };
+	return parse_statement();
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_while()
+{
+	lexer->consume();
+	expect(TOK_LPAREN, "[WHILE] Expected '(' after while!");
+	ast_ptr_t<stmt_t> condition = parse_expr();
+	expect(TOK_RPAREN, "[WHILE] Missing closing parenthesis!");
+
+	return arena->make<while_stmt_t>(std::move(condition), parse_body());
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_for()
+{
+	lexer->consume();
+	expect(TOK_LPAREN, "[FOR] Expected '(' after for!");
+
+	ast_ptr_t<for_stmt_t> loop = arena->make<for_stmt_t>();
+	if (lexer->current().type != TOK_ENDLINE)
+		loop->initializer = parse_assignment();
+	expect(TOK_ENDLINE, "[FOR] Missing semi-colon after the initializer!");
+
+	if (lexer->current().type != TOK_ENDLINE)
+		loop->condition = parse_expr();
+	expect(TOK_ENDLINE, "[FOR] Missing semi-colon after the condition!");
+
+	if (lexer->current().type != TOK_RPAREN)
+		loop->step = parse_assignment();
+	expect(TOK_RPAREN, "[FOR] Missing closing parenthesis!");
+
+	loop->body = parse_body();
+	return loop;
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_function()
+{
+	std::uint32_t start = lexer->consume().offset;
+
+	const token_t& name = lexer->consume();
+	if (name.type != TOK_IDENTIFIER)
+		throw std::runtime_error("[FUNCTION] Expected a name, got: \"" + std::string(lexer->text(name)) + "\"");
+
+	std::shared_ptr<script_function_t> function = std::make_shared<script_function_t>();
+	function->name = lexer->text(name);
+
+	expect(TOK_LPAREN, "[FUNCTION] Expected '(' after the name!");
+	if (lexer->current().type != TOK_RPAREN)
+	{
+		token_def_t current{};
+		do
+		{
+			const token_t& parameter = lexer->consume();
+			if (parameter.type != TOK_IDENTIFIER)
+				throw std::runtime_error("[FUNCTION] Expected a parameter name, got: \"" + std::string(lexer->text(parameter)) + "\"");
+
+			function->parameters.emplace_back(lexer->text(parameter));
+			current = lexer->consume().type;
+		} while (current == TOK_COMMA);
+
+		if (current != TOK_RPAREN)
+			throw std::runtime_error("[FUNCTION] Missing closing parenthesis!");
+	}
+	else
+		lexer->consume();
+
+	if (function->parameters.size() > UINT8_MAX)
+		throw std::runtime_error("[FUNCTION] Too many parameters!");
+
+	ast_arena_t* outer = arena;
+	arena = &function->arena;
+	function->body = std::move(parse_block()->statements);
+	arena = outer;
+
+	const token_t& end = lexer->get_tokens()[lexer->position() - 1]; // the }
+	function->source_offset = start;
+	function->source_length = end.offset + end.length - start;
+
+	return arena->make<function_stmt_t>(arena->make<identifier_expr_t>(function->name), std::move(function));
+}
+
+ast_ptr_t<stmt_t> parser_t::parse_statement()
 {
-	return parse_assignment();
+	const token_t& current = lexer->current();
+
+	if (current.type == TOK_CTXBEGIN)
+		return parse_block();
+
+	ast_ptr_t<stmt_t> statement{};
+	if (current.type == TOK_KEYWORD)
+	{
+		std::string_view keyword = lexer->text(current);
+		if (keyword == "if")
+			return parse_if();
+		if (keyword == "while")
+			return parse_while();
+		if (keyword == "for")
+			return parse_for();
+		if (keyword == "function")
+			return parse_function();
+
+		lexer->consume();
+		if (keyword == "return")
+			statement = arena->make<return_stmt_t>(lexer->current().type != TOK_ENDLINE ? parse_expr() : nullptr);
+		else if (keyword == "break")
+			statement = arena->make<stmt_t>(STMT_BREAK);
+		else if (keyword == "continue")
+			statement = arena->make<stmt_t>(STMT_CONTINUE);
+		else
+			throw std::runtime_error("Unexpected \"" + std::string(keyword) + "\""); // else without an if
+	}
+	else
+		statement = parse_assignment();
+
+	expect(TOK_ENDLINE, "Missing semi-colon!");
+	return statement;
 }
 
 std::unique_ptr<program_t> parser_t::parse_program()
 {
 	std::unique_ptr<program_t> program = std::make_unique<program_t>();
+	arena = &program->arena;
 
 	while (!lexer->is_done())
-	{
 		program->add_statement(parse_statement());
-		if (lexer->consume().type != TOK_ENDLINE)
-		{
-			throw std::exception("Missing semi-colon!");
-		}
-	}
 
 	return program;
 }
@@ -186,6 +498,12 @@ std::unique_ptr<program_t> parser_t::parse()
 	return parse_program();
 }
 
+ast_ptr_t<stmt_t> parser_t::parse_next(ast_arena_t& statement_arena)
+{
+	arena = &statement_arena;
+	return parse_statement();
+}
+
 
 
 // My parser is a tail recursive parser.
@@ -1,36 +1,94 @@
 #pragma once
 #include <cstdint>
+#include <algorithm>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 
 #include "../lexer/lexer.hpp"
+#include "arena.hpp"
 
 enum stmt_types_t
 {
 	STMT_PROGRAM,
 	STMT_ASSIGNMENT,
 	STMT_CALL,
+	STMT_BLOCK,
+	STMT_IF,
+	STMT_WHILE,
+	STMT_FOR,
+	STMT_FUNCTION,
+	STMT_RETURN,
+	STMT_BREAK,
+	STMT_CONTINUE,
 
 	EXPR_BINARY,
+	EXPR_LOGICAL,
 	EXPR_UNARY,
 	EXPR_NEGATE,
+	EXPR_COMPLEMENT,
 	EXPR_PRIMARY
 };
 
 enum primary_types_t
 {
 	PRIMARY_NUMBER,
+	PRIMARY_INTEGER,
 	PRIMARY_STRING,
 	PRIMARY_IDENTIFIER
 };
 
+// Same order as the arithmetic opcodes in bytecode.hpp.
+enum binary_operator_t : std::uint8_t
+{
+	BINARY_ADD,
+	BINARY_SUBTRACT,
+	BINARY_MULTIPLY,
+	BINARY_DIVIDE,
+	BINARY_MODULO,
+	BINARY_POWER,
+	BINARY_AND,
+	BINARY_OR,
+	BINARY_XOR,
+	BINARY_SHIFT_LEFT,
+	BINARY_SHIFT_RIGHT,
+	BINARY_EQUAL,			// comparisons give back integer 1 or 0
+	BINARY_NOT_EQUAL,
+	BINARY_LESS,
+	BINARY_LESS_EQUAL,
+	BINARY_GREATER,
+	BINARY_GREATER_EQUAL
+};
+
+const std::string binary_operator_strings[] = {
+	"+",
+	"-",
+	"*",
+	"/",
+	"%",
+	"^",
+	"&",
+	"|",
+	"~",
+	"<<",
+	">>",
+	"==",
+	"!=",
+	"<",
+	"<=",
+	">",
+	">="
+};
+
 // Not evaluated at compile time.
 class stmt_t
 {
 public:
 	stmt_t(stmt_types_t type) : type{ type } {};
-	virtual ~stmt_t() = default;
 
 	stmt_types_t type;
 };
@@ -40,14 +98,12 @@ class expr_ast_t : public stmt_t
 {
 public:
 	expr_ast_t(stmt_types_t type) : stmt_t{ type } {};
-	virtual ~expr_ast_t() = default;
 };
 
 class primary_expr_t : public expr_ast_t
 {
 public:
 	primary_expr_t(primary_types_t type) : type{ type }, expr_ast_t{ EXPR_PRIMARY } {}
-	virtual ~primary_expr_t() = default;
 
 	primary_types_t type;
 };
@@ -60,10 +116,18 @@ public:
 	float value;
 };
 
+class integer_expr_t : public primary_expr_t
+{
+public:
+	integer_expr_t(std::int64_t value) : value(value), primary_expr_t{ PRIMARY_INTEGER } {}
+
+	std::int64_t value;
+};
+
 class string_expr_t : public primary_expr_t
 {
 public:
-	string_expr_t(std::string value) : value{ value }, primary_expr_t{ PRIMARY_STRING } {}
+	string_expr_t(std::string value) : value{ std::move(value) }, primary_expr_t{ PRIMARY_STRING } {}
 
 	std::string value;
 };
@@ -74,48 +138,103 @@ public:
 	identifier_expr_t(std::string variable_name) : variable_name{ std::move(variable_name) }, primary_expr_t{PRIMARY_IDENTIFIER} {}
 
 	std::string variable_name;
+
+	// Filled in by resolver_t
+	std::uint32_t depth = 0;	// scope it lives in, 0 is the script's global scope
+	std::uint32_t slot = 0;		// index inside that scope
 };
 
 class binary_expr_t : public expr_ast_t
 {
 public:
 	binary_expr_t() = default;
-	binary_expr_t(std::unique_ptr<stmt_t> left, std::unique_ptr<stmt_t> right) : left{ std::move(left) }, right{ std::move(right) }, expr_ast_t{ EXPR_BINARY } {}
-	binary_expr_t(char operand, std::unique_ptr<stmt_t> left, std::unique_ptr<stmt_t> right) : operand{ operand }, left{ std::move(left) }, right{ std::move(right) }, expr_ast_t{ EXPR_BINARY } {}
+	binary_expr_t(ast_ptr_t<stmt_t> left, ast_ptr_t<stmt_t> right) : left{ std::move(left) }, right{ std::move(right) }, expr_ast_t{ EXPR_BINARY } {}
+	binary_expr_t(binary_operator_t operand, ast_ptr_t<stmt_t> left, ast_ptr_t<stmt_t> right) : operand{ operand }, left{ std::move(left) }, right{ std::move(right) }, expr_ast_t{ EXPR_BINARY } {}
 	
-	char operand = ' ';
-	std::unique_ptr<stmt_t> left;
-	std::unique_ptr<stmt_t> right;
+	binary_operator_t operand = BINARY_ADD;
+	ast_ptr_t<stmt_t> left;
+	ast_ptr_t<stmt_t> right;
 };
 
+// && and ||, only evaluates the right side when the left one doesn't decide it. Gives back whichever side decided.
+class logical_expr_t : public expr_ast_t
+{
+public:
+	logical_expr_t(bool is_and, ast_ptr_t<stmt_t> left, ast_ptr_t<stmt_t> right) : is_and{ is_and }, left{ std::move(left) }, right{ std::move(right) }, expr_ast_t{ EXPR_LOGICAL } {}
+
+	bool is_and = true;
+	ast_ptr_t<stmt_t> left;
+	ast_ptr_t<stmt_t> right;
+};
+
+// a + b + c parses into binary nodes nested to the left, as deep as the chain is long (&& and || chains too). Passes walk down the left of
+// a chain in a loop with these instead of recursing into it, so a huge generated expression can't run out of native stack.
+// Both give the chain's nodes innermost first (the first operator to run), that one's left is where the chain starts.
+template <typename node_t> // stmt_t or const stmt_t
+std::vector<node_t*> left_chain(node_t& root)
+{
+	using binary_t = std::conditional_t<std::is_const_v<node_t>, const binary_expr_t, binary_expr_t>;
+	using logical_t = std::conditional_t<std::is_const_v<node_t>, const logical_expr_t, logical_expr_t>;
+	auto left = [](node_t& node) -> node_t& { return node.type == EXPR_BINARY ? *static_cast<binary_t&>(node).left : *static_cast<logical_t&>(node).left; };
+
+	std::vector<node_t*> chain{ &root };
+	while (left(*chain.back()).type == root.type)
+		chain.push_back(&left(*chain.back()));
+
+	std::reverse(chain.begin(), chain.end());
+	return chain;
+}
+
+// Where each node of the chain is held, for passes that replace them
+inline std::vector<ast_ptr_t<stmt_t>*> left_chain_slots(ast_ptr_t<stmt_t>& root)
+{
+	auto left = [](stmt_t& node) -> ast_ptr_t<stmt_t>& { return node.type == EXPR_BINARY ? static_cast<binary_expr_t&>(node).left : static_cast<logical_expr_t&>(node).left; };
+
+	std::vector<ast_ptr_t<stmt_t>*> chain{ &root };
+	while (left(**chain.back())->type == root->type)
+		chain.push_back(&left(**chain.back()));
+
+	std::reverse(chain.begin(), chain.end());
+	return chain;
+}
+
 class unary_expr_t : public expr_ast_t
 {
 public:
 	unary_expr_t() = default;
-	unary_expr_t(std::unique_ptr<stmt_t> child) : child{ std::move(child) }, expr_ast_t{ EXPR_UNARY } {}
+	unary_expr_t(ast_ptr_t<stmt_t> child) : child{ std::move(child) }, expr_ast_t{ EXPR_UNARY } {}
 
-	std::unique_ptr<stmt_t> child;
+	ast_ptr_t<stmt_t> child;
 };
 
 class negate_expr_t : public expr_ast_t
 {
 public:
 	negate_expr_t() = default;
-	negate_expr_t(std::unique_ptr<stmt_t> child) : child{ std::move(child) }, expr_ast_t{ EXPR_NEGATE } {}
+	negate_expr_t(ast_ptr_t<stmt_t> child) : child{ std::move(child) }, expr_ast_t{ EXPR_NEGATE } {}
+
+	ast_ptr_t<stmt_t> child;
+};
+
+class complement_expr_t : public expr_ast_t
+{
+public:
+	complement_expr_t() = default;
+	complement_expr_t(ast_ptr_t<stmt_t> child) : child{ std::move(child) }, expr_ast_t{ EXPR_COMPLEMENT } {}
 
-	std::unique_ptr<stmt_t> child;
+	ast_ptr_t<stmt_t> child;
 };
 
 class call_stmt_t : public stmt_t
 {
 public:
 	call_stmt_t() = default;
-	call_stmt_t(std::unique_ptr<stmt_t> function) : function{ std::move(function) }, stmt_t{ STMT_CALL } {};
+	call_stmt_t(ast_ptr_t<stmt_t> function) : function{ std::move(function) }, stmt_t{ STMT_CALL } {};
 
-	std::unique_ptr<stmt_t> function; // We don't check if this is a valid value to assign in the parser (if it's an lvalue or value). That is job for semantic analysis.
-	std::vector<std::unique_ptr<stmt_t>> arguments; // We don't check if this is valid either.
+	ast_ptr_t<stmt_t> function; // We don't check if this is a valid value to assign in the parser (if it's an lvalue or value). That is job for semantic analysis.
+	std::vector<ast_ptr_t<stmt_t>> arguments; // We don't check if this is valid either.
 
-	void add_argument(std::unique_ptr<stmt_t> argument)
+	void add_argument(ast_ptr_t<stmt_t> argument)
 	{
 		arguments.push_back(std::move(argument));
 	}
@@ -125,10 +244,111 @@ class assignment_stmt_t : public stmt_t
 {
 public:
 	assignment_stmt_t() = default;
-	assignment_stmt_t(std::unique_ptr<stmt_t> variable, std::unique_ptr<stmt_t> assignment) : variable{ std::move(variable) }, assignment{ std::move(assignment) }, stmt_t{ STMT_ASSIGNMENT } {};
+	assignment_stmt_t(ast_ptr_t<stmt_t> variable, ast_ptr_t<stmt_t> assignment) : variable{ std::move(variable) }, assignment{ std::move(assignment) }, stmt_t{ STMT_ASSIGNMENT } {};
 
-	std::unique_ptr<stmt_t> variable; // We don't check if this is a valid value to assign in the parser (if it's an lvalue or value). That is job for semantic analysis.
-	std::unique_ptr<stmt_t> assignment;
+	ast_ptr_t<stmt_t> variable; // We don't check if this is a valid value to assign in the parser (if it's an lvalue or value). That is job for semantic analysis.
+	ast_ptr_t<stmt_t> assignment;
+};
+
+// Statements that give back a value. Only these print their result, and only at the top level of a script.
+inline bool is_expression_statement(const stmt_t& statement)
+{
+	return statement.type == STMT_ASSIGNMENT || statement.type == STMT_CALL || statement.type >= EXPR_BINARY;
+}
+
+class block_stmt_t : public stmt_t
+{
+public:
+	block_stmt_t() : stmt_t{ STMT_BLOCK } {};
+
+	std::vector<ast_ptr_t<stmt_t>> statements{};
+};
+
+class if_stmt_t : public stmt_t
+{
+public:
+	if_stmt_t(ast_ptr_t<stmt_t> condition, ast_ptr_t<stmt_t> then_branch, ast_ptr_t<stmt_t> else_branch) : condition{ std::move(condition) }, then_branch{ std::move(then_branch) }, else_branch{ std::move(else_branch) }, stmt_t{ STMT_IF } {};
+
+	ast_ptr_t<stmt_t> condition;
+	ast_ptr_t<stmt_t> then_branch;
+	ast_ptr_t<stmt_t> else_branch; // null without an else
+};
+
+// The ifs of an if / else if / else chain in order, each one is the else branch of the one before and the last one's else branch is the
+// final else (or null). Like left_chain the passes walk it in a loop, a long chain isn't nesting.
+template <typename if_t> // if_stmt_t or const if_stmt_t
+std::vector<if_t*> if_chain(if_t& root)
+{
+	std::vector<if_t*> chain{ &root };
+	while (chain.back()->else_branch && chain.back()->else_branch->type == STMT_IF)
+		chain.push_back(static_cast<if_t*>(chain.back()->else_branch.get()));
+
+	return chain;
+}
+
+class while_stmt_t : public stmt_t
+{
+public:
+	while_stmt_t(ast_ptr_t<stmt_t> condition, ast_ptr_t<stmt_t> body) : condition{ std::move(condition) }, body{ std::move(body) }, stmt_t{ STMT_WHILE } {};
+
+	ast_ptr_t<stmt_t> condition;
+	ast_ptr_t<stmt_t> body;
+};
+
+// for (initializer; condition; step) body, every part in the parenthesis can be left out.
+class for_stmt_t : public stmt_t
+{
+public:
+	for_stmt_t() : stmt_t{ STMT_FOR } {};
+
+	ast_ptr_t<stmt_t> initializer;
+	ast_ptr_t<stmt_t> condition; // null loops forever
+	ast_ptr_t<stmt_t> step;
+	ast_ptr_t<stmt_t> body;
+};
+
+class chunk_t;
+class jit_code_t;
+
+// A user defined function. Values of it can outlive the script that declared it (stored in a global, script cache drops the script), so it's shared instead of owned by the tree.
+class script_function_t
+{
+public:
+	std::string name{};
+	std::vector<std::string> parameters{};
+	ast_arena_t arena{};					// The body's nodes, declared first so they're still there while the body is torn down
+	std::vector<ast_ptr_t<stmt_t>> body{};
+
+	std::uint32_t locals = 0;				// Filled in by resolver_t, parameters take the first slots
+	std::vector<std::string> globals{};		// Filled in by resolver_t, global slot -> name (same as program_t::globals)
+	std::shared_ptr<chunk_t> chunk{};		// Filled in by compiler_t
+
+	std::uint32_t source_offset = 0;		// The declaration in the script, function keyword to closing }
+	std::uint32_t source_length = 0;
+	std::shared_ptr<const std::string> source{};	// Only for functions loaded from a script cache file, they have no body so the JIT parses the declaration again
+
+	// Machine code for it, see jit.hpp. Running changes these, the rest stays as compiled.
+	mutable std::atomic<std::uint32_t> calls = 0;
+	mutable std::once_flag native_once{};
+	mutable std::shared_ptr<const jit_code_t> native{};	// null until it's hot, and for good when it can't be compiled
+};
+
+// function name(parameters) { body }, assigns the function to name when it runs.
+class function_stmt_t : public stmt_t
+{
+public:
+	function_stmt_t(ast_ptr_t<stmt_t> variable, std::shared_ptr<script_function_t> function) : variable{ std::move(variable) }, function{ std::move(function) }, stmt_t{ STMT_FUNCTION } {};
+
+	ast_ptr_t<stmt_t> variable;
+	std::shared_ptr<script_function_t> function;
+};
+
+class return_stmt_t : public stmt_t
+{
+public:
+	return_stmt_t(ast_ptr_t<stmt_t> value) : value{ std::move(value) }, stmt_t{ STMT_RETURN } {};
+
+	ast_ptr_t<stmt_t> value; // null returns void
 };
 
 class program_t : public stmt_t
@@ -136,9 +356,11 @@ class program_t : public stmt_t
 public:
 	program_t() : stmt_t{ STMT_PROGRAM } {};
 
-	std::vector<std::unique_ptr<stmt_t>> statements{};
+	ast_arena_t arena{}; // Every node of the top level code (function bodies have their own)
+	std::vector<ast_ptr_t<stmt_t>> statements{};
+	std::vector<std::string> globals{}; // Filled in by resolver_t, global slot -> name
 
-	void add_statement(std::unique_ptr<stmt_t> statement)
+	void add_statement(ast_ptr_t<stmt_t> statement)
 	{
 		if (statement)
 		{
@@ -146,7 +368,7 @@ public:
 		}
 		else
 		{
-			throw std::exception("Attempt to add an empty statement to main block.");
+			throw std::runtime_error("Attempt to add an empty statement to main block.");
 		}
 	}
 };
@@ -154,28 +376,73 @@ public:
 class parser_t
 {
 private:
-	std::unique_ptr<lexer_t> lexer;
+	std::unique_ptr<lexer_t> owned_lexer{};
+	lexer_t* lexer = nullptr;
+	ast_arena_t* arena = nullptr; // where new nodes go, the program's or the function being parsed
+
+	// Every pass after parsing (and the tree walker) recurses once per level of nesting, too deep would run out of native stack. A level is a
+	// brace, a parenthesis (or call) and an if/while/for body without braces, 200 of them fit in a 1MB stack with room to spare in debug builds.
+	// Chains (1 + 1 + ..., else if) aren't nesting, they're loops in here and in the passes (see left_chain and if_chain).
+	static constexpr std::size_t max_nesting = 200;
+	std::size_t nesting = 0;
+
+	class nesting_t
+	{
+	private:
+		std::size_t& nesting;
+	public:
+		nesting_t(std::size_t& nesting) : nesting{ nesting }
+		{
+			if (++nesting > max_nesting)
+			{
+				--nesting;
+				throw std::runtime_error("Script is nested too deeply!");
+			}
+		}
+		~nesting_t() { --nesting; }
+	};
 
 	// Expressions
-	std::unique_ptr<stmt_t> parse_primary();
-	std::unique_ptr<stmt_t> parse_parenthesis();
-	std::unique_ptr<stmt_t> parse_unary_expr();
-	std::unique_ptr<stmt_t> parse_multiplicative_expr();
-	std::unique_ptr<stmt_t> parse_additive_expr();
-	std::unique_ptr<stmt_t> parse_expr();
+	ast_ptr_t<stmt_t> parse_primary();
+	ast_ptr_t<stmt_t> parse_parenthesis();
+	ast_ptr_t<stmt_t> parse_unary_expr();
+	ast_ptr_t<stmt_t> parse_multiplicative_expr();
+	ast_ptr_t<stmt_t> parse_additive_expr();
+	ast_ptr_t<stmt_t> parse_shift_expr();
+	ast_ptr_t<stmt_t> parse_bitwise_and_expr();
+	ast_ptr_t<stmt_t> parse_bitwise_xor_expr();
+	ast_ptr_t<stmt_t> parse_bitwise_or_expr();
+	ast_ptr_t<stmt_t> parse_comparison_expr();
+	ast_ptr_t<stmt_t> parse_logical_and_expr();
+	ast_ptr_t<stmt_t> parse_logical_or_expr();
+	ast_ptr_t<stmt_t> parse_expr();
 
 	// Statements
-	std::unique_ptr<stmt_t> parse_call(); // Technically an expression since it returns, todo: fix
-	std::unique_ptr<stmt_t> parse_assignment(); // Assignments CAN be expressions, todo: fix
-	std::unique_ptr<stmt_t> parse_statement();
+	ast_ptr_t<stmt_t> parse_call(); // Technically an expression since it returns, todo: fix
+	ast_ptr_t<stmt_t> parse_assignment(); // Assignments CAN be expressions, todo: fix
+	ast_ptr_t<block_stmt_t> parse_block();
+	ast_ptr_t<stmt_t> parse_body();
+	ast_ptr_t<stmt_t> parse_if();
+	ast_ptr_t<stmt_t> parse_while();
+	ast_ptr_t<stmt_t> parse_for();
+	ast_ptr_t<stmt_t> parse_function();
+	ast_ptr_t<stmt_t> parse_statement();
+
+	void expect(token_def_t type, const char* error); // consumes the current token, throws error if it isn't type
+	bool is_keyword(std::string_view keyword);
+	bool is_operator(std::string_view symbol); // current token is this operator
+	bool is_comparison();
 	std::unique_ptr<program_t> parse_program();
 public:
-	parser_t(const std::string& script)
+	parser_t(std::string_view script) // script has to stay alive while parsing, the tokens point into it
 	{
-		lexer = std::make_unique<lexer_t>(script);
+		owned_lexer = std::make_unique<lexer_t>(script);
+		lexer = owned_lexer.get();
 		lexer->tokenize();
 	};
+	parser_t(lexer_t& lexer) : lexer{ &lexer } {}; // already tokenized, parses from wherever it is
 	parser_t(parser_t&) = delete;
 
 	std::unique_ptr<program_t> parse();
+	ast_ptr_t<stmt_t> parse_next(ast_arena_t& arena); // one top level statement, the lexer ends up right after it
 };
\ No newline at end of file
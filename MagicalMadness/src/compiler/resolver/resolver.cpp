@@ -0,0 +1,271 @@
+#include <stdexcept>
+
+#include "resolver.hpp"
+
+void resolver_t::resolve_identifier(identifier_expr_t& identifier)
+{
+	// Reading something that isn't a local goes to the globals (other functions, natives)
+	if (function)
+	{
+		auto found = local_scope.find(identifier.variable_name);
+		if (found != local_scope.end())
+		{
+			identifier.depth = 1;
+			identifier.slot = found->second;
+			return;
+		}
+	}
+
+	identifier.depth = 0;
+
+	auto found = global_scope.find(identifier.variable_name);
+	if (found != global_scope.end())
+	{
+		identifier.slot = found->second;
+		return;
+	}
+
+	// Never seen before
+	if (globals->size() > UINT16_MAX)
+		throw std::runtime_error("Too many variables in one script!");
+
+	identifier.slot = static_cast<std::uint32_t>(globals->size());
+
+	global_scope.emplace(identifier.variable_name, identifier.slot);
+	globals->push_back(identifier.variable_name);
+}
+
+// Left side of an assignment
+void resolver_t::resolve_target(stmt_t& variable)
+{
+	if (variable.type == EXPR_PRIMARY && static_cast<primary_expr_t&>(variable).type == PRIMARY_IDENTIFIER)
+		resolve_identifier(static_cast<identifier_expr_t&>(variable));
+	else
+		resolve_node(variable); // the compiler complains about this one
+}
+
+// Assigning anywhere inside a function makes a local for the whole function, also where it's read before that assignment
+// (a loop reading what the previous iteration assigned, the else branch assigning what the then branch reads).
+void resolver_t::declare_locals(script_function_t& declaration)
+{
+	std::vector<stmt_t*> pending{};
+	for (auto statement = declaration.body.rbegin(); statement != declaration.body.rend(); ++statement)
+		pending.push_back(statement->get());
+
+	// Assignments are always statements, expressions can't hold one. Popped in source order so slots follow it
+	while (!pending.empty())
+	{
+		stmt_t& node = *pending.back();
+		pending.pop_back();
+
+		switch (node.type)
+		{
+			case STMT_ASSIGNMENT:
+			{
+				stmt_t& variable = *static_cast<assignment_stmt_t&>(node).variable;
+				if (variable.type != EXPR_PRIMARY || static_cast<primary_expr_t&>(variable).type != PRIMARY_IDENTIFIER)
+					break;
+
+				const std::string& name = static_cast<identifier_expr_t&>(variable).variable_name;
+				if (local_scope.contains(name))
+					break;
+
+				if (declaration.locals > UINT16_MAX)
+					throw std::runtime_error("Too many variables in function " + declaration.name + "!");
+
+				local_scope.emplace(name, declaration.locals++);
+				break;
+			}
+			case STMT_BLOCK:
+			{
+				std::vector<ast_ptr_t<stmt_t>>& statements = static_cast<block_stmt_t&>(node).statements;
+				for (auto statement = statements.rbegin(); statement != statements.rend(); ++statement)
+					pending.push_back(statement->get());
+				break;
+			}
+			case STMT_IF:
+			{
+				if_stmt_t& branch = static_cast<if_stmt_t&>(node);
+				if (branch.else_branch)
+					pending.push_back(branch.else_branch.get());
+				pending.push_back(branch.then_branch.get());
+				break;
+			}
+			case STMT_WHILE:
+				pending.push_back(static_cast<while_stmt_t&>(node).body.get());
+				break;
+			case STMT_FOR:
+			{
+				for_stmt_t& loop = static_cast<for_stmt_t&>(node);
+				pending.push_back(loop.body.get());
+				if (loop.step)
+					pending.push_back(loop.step.get());
+				if (loop.initializer)
+					pending.push_back(loop.initializer.get());
+				break;
+			}
+			default:
+				break;
+		}
+	}
+}
+
+void resolver_t::resolve_function(script_function_t& declaration)
+{
+	if (function)
+		throw std::runtime_error("Function " + declaration.name + " is declared inside function " + function->name + ", functions can only be declared outside of them!");
+
+	// Functions get their own globals table, a value of one can be called from another script with a different one
+	std::unordered_map<std::string, std::uint32_t> script_scope = std::move(global_scope);
+	std::vector<std::string>* script_globals = globals;
+
+	global_scope.clear();
+	globals = &declaration.globals;
+	globals->clear();
+	local_scope.clear();
+	function = &declaration;
+	function->locals = 0;
+
+	for (const std::string& parameter : declaration.parameters)
+	{
+		if (!local_scope.emplace(parameter, function->locals++).second)
+			throw std::runtime_error("Function " + declaration.name + " has parameter " + parameter + " twice!");
+	}
+
+	declare_locals(declaration);
+
+	for (ast_ptr_t<stmt_t>& statement : declaration.body)
+		resolve_node(*statement);
+
+	function = nullptr;
+	local_scope.clear();
+	global_scope = std::move(script_scope);
+	globals = script_globals;
+}
+
+void resolver_t::resolve_node(stmt_t& node)
+{
+	switch (node.type)
+	{
+		case STMT_PROGRAM:
+		{
+			for (ast_ptr_t<stmt_t>& statement : static_cast<program_t&>(node).statements)
+				resolve_node(*statement);
+			break;
+		}
+		case STMT_ASSIGNMENT:
+		{
+			assignment_stmt_t& assignment = static_cast<assignment_stmt_t&>(node);
+			resolve_node(*assignment.assignment);
+			resolve_target(*assignment.variable);
+			break;
+		}
+		case STMT_CALL:
+		{
+			call_stmt_t& call = static_cast<call_stmt_t&>(node);
+			resolve_node(*call.function);
+			for (ast_ptr_t<stmt_t>& argument : call.arguments)
+				resolve_node(*argument);
+			break;
+		}
+		case STMT_BLOCK:
+		{
+			for (ast_ptr_t<stmt_t>& statement : static_cast<block_stmt_t&>(node).statements)
+				resolve_node(*statement);
+			break;
+		}
+		case STMT_IF:
+		{
+			std::vector<if_stmt_t*> chain = if_chain(static_cast<if_stmt_t&>(node)); // else if chains in a loop
+			for (if_stmt_t* branch : chain)
+			{
+				resolve_node(*branch->condition);
+				resolve_node(*branch->then_branch);
+			}
+			if (chain.back()->else_branch)
+				resolve_node(*chain.back()->else_branch);
+			break;
+		}
+		case STMT_WHILE:
+		{
+			while_stmt_t& loop = static_cast<while_stmt_t&>(node);
+			resolve_node(*loop.condition);
+			resolve_node(*loop.body);
+			break;
+		}
+		case STMT_FOR:
+		{
+			for_stmt_t& loop = static_cast<for_stmt_t&>(node);
+			if (loop.initializer)
+				resolve_node(*loop.initializer);
+			if (loop.condition)
+				resolve_node(*loop.condition);
+			if (loop.step)
+				resolve_node(*loop.step);
+			resolve_node(*loop.body);
+			break;
+		}
+		case STMT_FUNCTION:
+		{
+			function_stmt_t& declaration = static_cast<function_stmt_t&>(node);
+			resolve_target(*declaration.variable); // before the body so it can call itself
+			resolve_function(*declaration.function);
+			break;
+		}
+		case STMT_RETURN:
+		{
+			return_stmt_t& return_statement = static_cast<return_stmt_t&>(node);
+			if (return_statement.value)
+				resolve_node(*return_statement.value);
+			break;
+		}
+		case STMT_BREAK:
+		case STMT_CONTINUE:
+			break;
+		case EXPR_BINARY:
+		{
+			std::vector<stmt_t*> chain = left_chain(node); // long chains in a loop
+			resolve_node(*static_cast<binary_expr_t*>(chain.front())->left);
+			for (stmt_t* link : chain)
+				resolve_node(*static_cast<binary_expr_t*>(link)->right);
+			break;
+		}
+		case EXPR_LOGICAL:
+		{
+			std::vector<stmt_t*> chain = left_chain(node);
+			resolve_node(*static_cast<logical_expr_t*>(chain.front())->left);
+			for (stmt_t* link : chain)
+				resolve_node(*static_cast<logical_expr_t*>(link)->right);
+			break;
+		}
+		case EXPR_UNARY:
+			resolve_node(*static_cast<unary_expr_t&>(node).child);
+			break;
+		case EXPR_NEGATE:
+			resolve_node(*static_cast<negate_expr_t&>(node).child);
+			break;
+		case EXPR_COMPLEMENT:
+			resolve_node(*static_cast<complement_expr_t&>(node).child);
+			break;
+		case EXPR_PRIMARY:
+		{
+			primary_expr_t& primary = static_cast<primary_expr_t&>(node);
+			if (primary.type == PRIMARY_IDENTIFIER)
+				resolve_identifier(static_cast<identifier_expr_t&>(primary));
+			break;
+		}
+		default:
+			throw std::runtime_error("[Resolver] Unexpected statement: " + std::to_string(node.type));
+	}
+}
+
+void resolver_t::resolve(program_t& program)
+{
+	global_scope.clear();
+	globals = &program.globals;
+	globals->clear();
+	local_scope.clear();
+	function = nullptr;
+
+	resolve_node(program);
+}
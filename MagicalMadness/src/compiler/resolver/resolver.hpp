@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../parser/parser.hpp"
+
+// Runs after parsing, binds every identifier to a (depth, slot) pair so nothing is looked up by name while running.
+// Depth 0 is global, depth 1 a local of the function being resolved (parameters, and anything assigned inside it).
+// Global slots are per script and per function, they're linked to the environment's by name once (per run, or when a function is declared).
+class resolver_t
+{
+private:
+	std::unordered_map<std::string, std::uint32_t> global_scope{};
+	std::vector<std::string>* globals = nullptr;
+
+	std::unordered_map<std::string, std::uint32_t> local_scope{};
+	script_function_t* function = nullptr; // null outside functions
+
+	void resolve_identifier(identifier_expr_t& identifier);
+	void resolve_target(stmt_t& variable);
+	void declare_locals(script_function_t& declaration);
+	void resolve_function(script_function_t& declaration);
+	void resolve_node(stmt_t& node);
+public:
+	resolver_t() = default;
+	resolver_t(const resolver_t&) = delete;
+
+	void resolve(program_t& program);
+};
@@ -0,0 +1,119 @@
+#include <stdexcept>
+
+#include "script.hpp"
+#include "../optimizer/optimizer.hpp"
+#include "../resolver/resolver.hpp"
+#include "../bytecode/compiler.hpp"
+#include "script_file.hpp"
+#include "../interpreter/include/interpreter.hpp"
+#include "../interpreter/include/vm.hpp"
+
+script_t::script_t(const std::string& source) : source{ source }
+{
+	parser_t parser{ source };
+	program = parser.parse();
+
+	optimizer_t optimizer{};
+	optimizer.optimize(*program);
+
+	resolver_t resolver{};
+	resolver.resolve(*program);
+
+	compiler_t compiler{};
+	chunk = compiler.compile(*program);
+}
+
+script_t::script_t(const std::string& source, std::unique_ptr<chunk_t> chunk) : source{ source }, chunk{ std::move(chunk) }
+{
+}
+
+value_t script_t::run(execution_state_t& state) const
+{
+	return interpreter::run_bytecode(*chunk, state);
+}
+
+value_t script_t::interpret(environment_t& environment) const
+{
+	if (!program)
+		throw std::runtime_error("This script was loaded from the script cache, there's no tree to walk!");
+
+	return interpreter::run_tree(*program, environment);
+}
+
+const std::string& script_t::get_source() const
+{
+	return source;
+}
+
+bool script_t::has_program() const
+{
+	return program != nullptr;
+}
+
+const program_t& script_t::get_program() const
+{
+	return *program;
+}
+
+const chunk_t& script_t::get_chunk() const
+{
+	return *chunk;
+}
+
+std::shared_ptr<const script_t> script_cache_t::get(const std::string& source)
+{
+	std::lock_guard lock{ mutex };
+
+	auto found = scripts.find(source);
+	if (found != scripts.end())
+		return found->second;
+
+	std::shared_ptr<const script_t> script = load_or_compile(source);
+
+	if (scripts.size() >= capacity) // Scripts are typed by hand, there are never many. Starting over is simpler than tracking use.
+		scripts.clear();
+
+	scripts.emplace(source, script);
+	return script;
+}
+
+void script_cache_t::clear()
+{
+	std::lock_guard lock{ mutex };
+	scripts.clear();
+}
+
+void script_cache_t::set_directory(const std::string& path)
+{
+	std::lock_guard lock{ mutex };
+	directory = path;
+}
+
+std::shared_ptr<const script_t> script_cache_t::load_or_compile(const std::string& source)
+{
+	if (directory.empty())
+	{
+		++compiled;
+		return std::make_shared<const script_t>(source);
+	}
+
+	if (std::unique_ptr<chunk_t> chunk = script_file::load(directory, source))
+	{
+		++loaded;
+		return std::make_shared<const script_t>(source, std::move(chunk));
+	}
+
+	std::shared_ptr<const script_t> script = std::make_shared<const script_t>(source);
+	++compiled;
+
+	try
+	{
+		script_file::save(directory, source, script->get_chunk());
+	}
+	catch (std::exception& err)
+	{
+		std::printf("%s (%s)\n", err.what(), directory.c_str()); // it still runs, it just gets compiled again next time
+	}
+
+	return script;
+}
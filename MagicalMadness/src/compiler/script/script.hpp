@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "../parser/parser.hpp"
+#include "../bytecode/bytecode.hpp"
+#include "../interpreter/include/basetypes.hpp"
+
+// A script that has been lexed, parsed, optimized and compiled once. Running it doesn't touch the tree or the chunk, so it can be run any number of times (once per function in a binary, etc).
+class script_t
+{
+private:
+	std::string source{};
+	std::unique_ptr<program_t> program{};
+	std::unique_ptr<chunk_t> chunk{};
+public:
+	script_t(const std::string& source); // throws on lexer/parser/compiler errors
+	script_t(const std::string& source, std::unique_ptr<chunk_t> chunk); // loaded from a script cache file, there's no tree
+	script_t(const script_t&) = delete;
+
+	value_t run(execution_state_t& state) const;		// bytecode VM
+	value_t interpret(environment_t& environment) const;	// tree walker, slower but handy for checking the VM (throws for loaded scripts)
+
+	const std::string& get_source() const;
+	bool has_program() const;
+	const program_t& get_program() const;
+	const chunk_t& get_chunk() const;
+};
+
+// Compiled scripts keyed by their source, running the same text again skips straight to execution.
+// With a directory set, misses look for the script on disk before compiling it (and save it there after), see script_file.hpp.
+class script_cache_t
+{
+private:
+	std::mutex mutex{};
+	std::unordered_map<std::string, std::shared_ptr<const script_t>> scripts{};
+	std::size_t capacity = 64;
+	std::string directory{};
+
+	std::shared_ptr<const script_t> load_or_compile(const std::string& source);
+public:
+	script_cache_t() = default;
+	script_cache_t(std::size_t capacity) : capacity{ capacity } {};
+	script_cache_t(const script_cache_t&) = delete;
+
+	std::shared_ptr<const script_t> get(const std::string& source); // compiles on a miss, throws like script_t
+	void clear();
+	void set_directory(const std::string& path); // empty = memory only
+
+	std::size_t loaded = 0;		// misses found on disk
+	std::size_t compiled = 0;	// misses compiled
+};
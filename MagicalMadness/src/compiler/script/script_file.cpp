@@ -0,0 +1,281 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "script_file.hpp"
+#include "../parser/parser.hpp"
+
+// Layout (little endian, strings are a u32 length then the bytes):
+//	u32 magic, u32 version, u64 checksum of everything after it, u64 source hash, string source, chunk
+//	chunk:		u32 max_stack, u32 code size + code, u32 count + constants, u32 count + names, u32 count + functions
+//	constant:	u8 runtime_type, then i64 for integers, f32 for numbers, string for strings
+//	function:	string name, u32 count + parameters, u32 locals, u32 count + globals, u32 source offset, u32 source length, chunk
+static constexpr std::uint32_t magic = 0x43534D4D; // MMSC
+
+class file_writer_t
+{
+public:
+	std::vector<std::uint8_t> bytes{};
+
+	template <typename type_t>
+	void write(type_t value)
+	{
+		std::size_t old = bytes.size();
+		bytes.resize(old + sizeof(type_t));
+		std::memcpy(bytes.data() + old, &value, sizeof(type_t));
+	}
+
+	void write_string(std::string_view text)
+	{
+		write<std::uint32_t>(static_cast<std::uint32_t>(text.size()));
+		bytes.insert(bytes.end(), text.begin(), text.end());
+	}
+
+	void write_strings(const std::vector<std::string>& strings)
+	{
+		write<std::uint32_t>(static_cast<std::uint32_t>(strings.size()));
+		for (const std::string& text : strings)
+			write_string(text);
+	}
+
+	void write_chunk(const chunk_t& chunk)
+	{
+		write<std::uint32_t>(static_cast<std::uint32_t>(chunk.max_stack));
+		write_string(std::string_view{ reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size() });
+
+		write<std::uint32_t>(static_cast<std::uint32_t>(chunk.constants.size()));
+		for (const value_t& constant : chunk.constants)
+		{
+			write<std::uint8_t>(static_cast<std::uint8_t>(constant.type));
+			if (constant.type == RUNTIME_INTEGER)
+				write<std::int64_t>(constant.integer);
+			else if (constant.type == RUNTIME_NUMBER)
+				write<float>(constant.number);
+			else if (constant.type == RUNTIME_STRING)
+				write_string(constant.as_string().text());
+			else
+				throw std::runtime_error("Only numbers and strings can be saved as constants!");
+		}
+
+		write_strings(chunk.names);
+
+		write<std::uint32_t>(static_cast<std::uint32_t>(chunk.functions.size()));
+		for (const std::shared_ptr<const script_function_t>& function : chunk.functions)
+		{
+			write_string(function->name);
+			write_strings(function->parameters);
+			write<std::uint32_t>(function->locals);
+			write_strings(function->globals);
+			write<std::uint32_t>(function->source_offset);
+			write<std::uint32_t>(function->source_length);
+			write_chunk(*function->chunk);
+		}
+	}
+};
+
+// Every read is checked against the end, a cut off or damaged file throws instead of reading past it
+class file_reader_t
+{
+private:
+	const std::uint8_t* at;
+	const std::uint8_t* end;
+	std::shared_ptr<const std::string> source{}; // handed to every function for the JIT
+public:
+	file_reader_t(const std::vector<std::uint8_t>& bytes) : at{ bytes.data() }, end{ bytes.data() + bytes.size() } {};
+
+	const std::uint8_t* take(std::size_t size)
+	{
+		if (static_cast<std::size_t>(end - at) < size)
+			throw std::runtime_error("Script cache file is cut off!");
+
+		const std::uint8_t* taken = at;
+		at += size;
+		return taken;
+	}
+
+	template <typename type_t>
+	type_t read()
+	{
+		type_t value;
+		std::memcpy(&value, take(sizeof(type_t)), sizeof(type_t));
+		return value;
+	}
+
+	std::string_view read_string()
+	{
+		std::uint32_t size = read<std::uint32_t>();
+		return { reinterpret_cast<const char*>(take(size)), size };
+	}
+
+	std::vector<std::string> read_strings()
+	{
+		std::uint32_t count = read<std::uint32_t>();
+		std::vector<std::string> strings{};
+		strings.reserve(std::min<std::size_t>(count, end - at)); // a damaged count runs out of bytes instead of memory
+		for (std::uint32_t i = 0; i < count; ++i)
+			strings.emplace_back(read_string());
+
+		return strings;
+	}
+
+	void set_source(std::shared_ptr<const std::string> value)
+	{
+		source = std::move(value);
+	}
+
+	std::unique_ptr<chunk_t> read_chunk()
+	{
+		std::unique_ptr<chunk_t> chunk = std::make_unique<chunk_t>();
+		chunk->max_stack = read<std::uint32_t>();
+
+		std::string_view code = read_string();
+		chunk->code.assign(code.begin(), code.end());
+
+		std::uint32_t constants = read<std::uint32_t>();
+		chunk->constants.reserve(std::min<std::size_t>(constants, end - at));
+		for (std::uint32_t i = 0; i < constants; ++i)
+		{
+			runtime_type type = static_cast<runtime_type>(read<std::uint8_t>());
+			if (type == RUNTIME_INTEGER)
+				chunk->constants.emplace_back(read<std::int64_t>());
+			else if (type == RUNTIME_NUMBER)
+				chunk->constants.emplace_back(read<float>());
+			else if (type == RUNTIME_STRING)
+				chunk->constants.push_back(value_t::make<runtime_string_t>(std::string{ read_string() }));
+			else
+				throw std::runtime_error("Script cache file has a bad constant!");
+		}
+
+		chunk->names = read_strings();
+
+		std::uint32_t functions = read<std::uint32_t>();
+		for (std::uint32_t i = 0; i < functions; ++i)
+		{
+			std::shared_ptr<script_function_t> function = std::make_shared<script_function_t>();
+			function->name = read_string();
+			function->parameters = read_strings();
+			function->locals = read<std::uint32_t>();
+			function->globals = read_strings();
+			function->source_offset = read<std::uint32_t>();
+			function->source_length = read<std::uint32_t>();
+			function->source = source;
+			function->chunk = read_chunk();
+
+			if (function->parameters.size() > function->locals || static_cast<std::size_t>(function->source_offset) + function->source_length > source->size())
+				throw std::runtime_error("Script cache file has a bad function!");
+
+			chunk->functions.push_back(std::move(function));
+		}
+
+		return chunk;
+	}
+
+	bool is_done() const
+	{
+		return at == end;
+	}
+};
+
+std::uint64_t script_file::hash(std::string_view source)
+{
+	std::uint64_t hash = 0xCBF29CE484222325; // FNV-1a
+	for (char character : source)
+	{
+		hash ^= static_cast<std::uint8_t>(character);
+		hash *= 0x100000001B3;
+	}
+
+	return hash;
+}
+
+std::string script_file::path(const std::string& directory, std::string_view source)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.mmsc", static_cast<unsigned long long>(hash(source)));
+	return (std::filesystem::path{ directory } / name).string();
+}
+
+std::unique_ptr<chunk_t> script_file::load(const std::string& directory, const std::string& source)
+{
+	std::ifstream file{ path(directory, source), std::ios::binary | std::ios::ate };
+	if (!file)
+		return {};
+
+	std::vector<std::uint8_t> bytes{};
+	std::streamoff size = file.tellg();
+	if (size > 0 && file.seekg(0))
+	{
+		bytes.resize(static_cast<std::size_t>(size));
+		if (!file.read(reinterpret_cast<char*>(bytes.data()), size))
+			bytes.clear();
+	}
+	file.close();
+
+	try
+	{
+		// The VM trusts a chunk's operands, a damaged file can't get that far
+		file_reader_t reader{ bytes };
+		if (reader.read<std::uint32_t>() != magic || reader.read<std::uint32_t>() != version)
+			return {};
+
+		std::uint64_t checksum = reader.read<std::uint64_t>();
+		if (checksum != hash({ reinterpret_cast<const char*>(bytes.data()) + 16, bytes.size() - 16 }))
+			throw std::runtime_error("Script cache file is damaged!");
+
+		if (reader.read<std::uint64_t>() != hash(source))
+			return {};
+
+		if (reader.read_string() != source)
+			return {}; // same hash, different script. It gets compiled and takes the file over.
+
+		reader.set_source(std::make_shared<const std::string>(source));
+		std::unique_ptr<chunk_t> chunk = reader.read_chunk();
+		if (!reader.is_done())
+			throw std::runtime_error("Script cache file has extra bytes!");
+
+		return chunk;
+	}
+	catch (std::exception& err)
+	{
+		std::printf("%s Compiling the script again.\n", err.what());
+		return {};
+	}
+}
+
+void script_file::save(const std::string& directory, const std::string& source, const chunk_t& chunk)
+{
+	file_writer_t writer{};
+	writer.write<std::uint32_t>(magic);
+	writer.write<std::uint32_t>(version);
+	writer.write<std::uint64_t>(0);
+	writer.write<std::uint64_t>(hash(source));
+	writer.write_string(source);
+	writer.write_chunk(chunk);
+
+	std::uint64_t checksum = hash({ reinterpret_cast<const char*>(writer.bytes.data()) + 16, writer.bytes.size() - 16 });
+	std::memcpy(writer.bytes.data() + 8, &checksum, sizeof(checksum));
+
+	std::filesystem::create_directories(directory);
+
+	// Written next to it and renamed over it, so a batch running at the same time never reads half a file
+	std::string target = path(directory, source);
+	std::string temporary = target + ".tmp";
+
+	std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+	if (!file)
+		throw std::runtime_error("Failed to write to the script cache!");
+
+	file.write(reinterpret_cast<const char*>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+	file.close();
+	if (!file)
+	{
+		std::error_code ignored{};
+		std::filesystem::remove(temporary, ignored);
+		throw std::runtime_error("Failed to write to the script cache!");
+	}
+
+	std::filesystem::rename(temporary, target);
+}
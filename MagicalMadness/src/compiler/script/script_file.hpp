@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "../bytecode/bytecode.hpp"
+
+// Compiled scripts saved to disk, so a library of scripts run in batch mode isn't lexed, parsed & compiled again every time.
+// One file per script named after the hash of its source, it holds the source too (a hash match alone isn't proof) and the chunk with
+// every function in it. Loading is a single read, then the chunk is rebuilt straight from the bytes. There are no trees, so loaded
+// scripts can only run on the VM (the JIT parses a hot function's declaration again, see jit.cpp).
+namespace script_file
+{
+	// Part of every file, one saved by a different version is compiled again. Bump it whenever the bytecode, what compiler_t
+	// makes of a script or the layout below changes.
+	constexpr std::uint32_t version = 2;
+
+	std::uint64_t hash(std::string_view source);
+	std::string path(const std::string& directory, std::string_view source);
+
+	std::unique_ptr<chunk_t> load(const std::string& directory, const std::string& source); // null when there's no (usable) file for it
+	void save(const std::string& directory, const std::string& source, const chunk_t& chunk); // throws when it can't be written
+}
@@ -1,23 +1,87 @@
 #define ZYDIS_STATIC_BUILD
 
 #include "disassembler.hpp"
+#include "profiler/profiler.hpp"
 #include <Zydis/Disassembler.h>
 #include <zydis/SharedTypes.h>
 
+// Pulls out the parts of a decoded instruction that are worth searching for (mnemonic, registers, constants).
+static void record_instruction(std::vector<instruction_t>& instructions, const ZydisDisassembledInstruction& instruction, std::uint32_t address, std::uint32_t text_offset, std::uint32_t text_length)
+{
+	instruction_t& record = instructions.emplace_back();
+	record.address = address;
+	record.text_offset = text_offset;
+	record.text_length = static_cast<std::uint16_t>(text_length);
+	record.mnemonic = static_cast<std::uint16_t>(instruction.info.mnemonic);
+	record.length = instruction.info.length;
+
+	auto add_register = [&record](ZydisRegister reg)
+	{
+		if (reg == ZYDIS_REGISTER_NONE || record.register_count >= std::size(record.registers))
+			return;
+
+		ZydisRegister enclosing = ZydisRegisterGetLargestEnclosing(ZYDIS_MACHINE_MODE_LEGACY_32, reg);
+		record.registers[record.register_count++] = static_cast<std::uint16_t>(enclosing != ZYDIS_REGISTER_NONE ? enclosing : reg);
+	};
+
+	// Kept zero extended to the width they're used at, the way the listing prints them: and eax, -16 is stored as 0xFFFFFFF0
+	// and [0x80001000] as an address instead of a negative number
+	auto add_constant = [&record](std::uint64_t value, std::uint16_t bits)
+	{
+		if (bits && bits < 64)
+			value &= (std::uint64_t{ 1 } << bits) - 1;
+
+		if (record.constant_count < std::size(record.constants))
+			record.constants[record.constant_count++] = static_cast<std::int64_t>(value);
+	};
+
+	for (std::uint8_t i = 0; i < instruction.info.operand_count_visible; ++i)
+	{
+		const ZydisDecodedOperand& operand = instruction.operands[i];
+		switch (operand.type)
+		{
+			case ZYDIS_OPERAND_TYPE_REGISTER:
+				add_register(operand.reg.value);
+				break;
+			case ZYDIS_OPERAND_TYPE_MEMORY:
+				add_register(operand.mem.base);
+				add_register(operand.mem.index);
+				if (operand.mem.disp.has_displacement)
+					add_constant(static_cast<std::uint64_t>(operand.mem.disp.value), instruction.info.address_width);
+				break;
+			case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+				if (operand.imm.is_relative) // branches store where they go, not how far
+					add_constant(address + instruction.info.length + operand.imm.value.u, 32);
+				else
+					add_constant(operand.imm.value.u, operand.size);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
 // Thanks Zydis for making this simple
 std::string& disassembler_t::disassemble(std::uint32_t loaded_base)
 {
+	PROFILE_SCOPE("disassembler_t::disassemble");
 	this->disassembled = "";
+	this->instructions.clear();
 	if (this->bounds.has_read != true || this->bounds.is_code != true)
 		return this->disassembled;
 
+	this->instructions.reserve((this->bounds.end_address - this->bounds.start_address) / 3); // x86 averages ~3 bytes an instruction
+
 	char formatted_text[100]{0}; // more than enough for no stack corrupt
 	std::uint32_t current_ptr = loaded_base + this->bounds.start_address;
 	while (current_ptr < loaded_base + this->bounds.end_address)
 	{
 		ZydisDisassembledInstruction instruction{};
 		ZydisDisassembleIntel(ZYDIS_MACHINE_MODE_LEGACY_32, loaded_base, reinterpret_cast<void*>(current_ptr), 50, &instruction);
-		sprintf_s(formatted_text, "[0x%p]: %s\n", current_ptr, instruction.text);
+		int written = sprintf_s(formatted_text, "[0x%p]: %s\n", current_ptr, instruction.text);
+
+		record_instruction(this->instructions, instruction, current_ptr, static_cast<std::uint32_t>(this->disassembled.size()), written > 0 ? written - 1 : 0);
+
 		this->disassembled += formatted_text;
 		std::memset(formatted_text, 0, 100);
 		current_ptr += (instruction.info.length ? instruction.info.length : 1);
@@ -29,4 +93,9 @@ std::string& disassembler_t::disassemble(std::uint32_t loaded_base)
 std::string& disassembler_t::get_previous_disassembly()
 {
 	return this->disassembled;
-}
\ No newline at end of file
+}
+
+std::vector<instruction_t>& disassembler_t::get_instructions()
+{
+	return this->instructions;
+}
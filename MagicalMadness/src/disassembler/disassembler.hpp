@@ -1,13 +1,16 @@
 #pragma once
 #include <iostream>
 #include <cstdint>
+#include <vector>
 
 #include "loader/loader.hpp"
+#include "instruction.hpp"
 
 class disassembler_t
 {
 private:
 	std::string disassembled{};
+	std::vector<instruction_t> instructions{};
 	section_t bounds;
 public:
 	disassembler_t(section_t section) : bounds{ section } {};
@@ -15,4 +18,5 @@ public:
 
 	std::string& disassemble(std::uint32_t loaded_base);
 	std::string& get_previous_disassembly();
-};
\ No newline at end of file
+	std::vector<instruction_t>& get_instructions();
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+// Compact machine readable record of one decoded instruction.
+// Kept next to the formatted listing so things like searching never have to decode or parse text again.
+struct instruction_t
+{
+	std::uint32_t address = 0;			// Mapped address (the same one printed in the listing)
+	std::uint32_t text_offset = 0;		// Where this instruction's line starts inside the section's formatted listing
+	std::uint16_t text_length = 0;		// Line length without the trailing newline
+	std::uint16_t mnemonic = 0;			// ZydisMnemonic
+	std::uint16_t registers[4]{ 0 };	// Largest enclosing ZydisRegister of the register & memory operands (al, ax and eax are all stored as eax)
+	std::int64_t constants[2]{ 0 };		// Immediates and displacements zero extended to their width, relative branches store their (mapped) target
+	std::uint8_t length = 0;
+	std::uint8_t register_count = 0;
+	std::uint8_t constant_count = 0;
+};
@@ -1,7 +1,22 @@
-#include <Windows.h>
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <tuple>
+#include <algorithm>
+
+#include "interface/headless/headless.hpp"
+#include "compiler/script/script.hpp"
+#include "compiler/jit/jit.hpp"
+#include "scripting/script_runner.hpp"
 
+#ifdef _WIN32
+#include <Windows.h>
 #include "loader/loader.hpp"
 #include "interface/interface.hpp"
 
@@ -27,45 +42,232 @@ LONG custom_exception_handler(PEXCEPTION_POINTERS exception_info)
 	return EXCEPTION_CONTINUE_SEARCH;
 }
 
-int main(int argc, char* argv[])
+#endif
+
+// [file to analyze | synthetic instruction count] argument of the modes below, false when it can't be analyzed here
+bool analyze_argument(const char* argument, loader_output_t& output)
 {
-	std::printf("Welcome to Magical Madness!\n");
-	
-	// If any errors occur this will be the backbone which catches those errors and gives you a chance to see what went wrong (will make bug hunting MUCH easier)
-	SetUnhandledExceptionFilter(reinterpret_cast<LPTOP_LEVEL_EXCEPTION_FILTER>(&custom_exception_handler));
+	char* end = nullptr;
+	std::uint32_t instruction_count = argument ? std::strtoul(argument, &end, 0) : 1000000;
+	if (argument && *end != '\0')
+	{
+#ifdef _WIN32
+		loader_t executable{ argument };
+		executable.analyze(output);
+#else
+		std::printf("Analyzing files needs Windows, pass an instruction count to use a synthetic listing instead.\n");
+		return false;
+#endif
+	}
+	else
+		make_synthetic_output(output, instruction_count);
 
-	create_console();
+	return true;
+}
+
+// MagicalMadness.exe --headless-bench <frames> [file to analyze | synthetic instruction count]
+// Renders every view without a window or GPU and prints frame time statistics, for catching UI performance regressions.
+int run_headless_benchmark(int argc, char* argv[])
+{
+	std::uint32_t frames = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 600;
+	loader_output_t output{};
+	if (!analyze_argument(argc > 3 ? argv[3] : nullptr, output))
+		return 1;
+
+	headless_t headless{};
+	headless.run(output, 10); // warm up (first frames build fonts, window settings & search tables)
 
-	if (argc != 2) // First argument is it's own file path.
+	headless_stats_t stats = headless.run(output, frames);
+	std::printf("Headless benchmark: %u frames\n\tmin: %.3fms\n\tavg: %.3fms\n\tmedian: %.3fms\n\tp99: %.3fms\n\tmax: %.3fms\n\tvertices: %llu\n\tindices: %llu\n",
+		stats.frames, stats.min_ms, stats.average_ms, stats.median_ms, stats.p99_ms, stats.max_ms,
+		static_cast<unsigned long long>(stats.vertices), static_cast<unsigned long long>(stats.indices));
+
+	return 0;
+}
+
+// MagicalMadness.exe --script-bench [iterations]
+// Times the same loops on the tree walker and the VM and prints how long one iteration takes, for catching interpreter performance regressions.
+int run_script_benchmark(int argc, char* argv[])
+{
+	std::int64_t iterations = argc > 2 ? std::strtoll(argv[2], nullptr, 0) : 1000000;
+
+	// Blocks keep the top level assignments from printing their result. The third one is the function the JIT has to compile on x86-64, the
+	// last one the error every mode has to end with. bailouts leaves hot machine code from inside an expression with a temporary still pushed.
+	const std::tuple<const char*, const char*, const char*, const char*> benchmarks[] = {
+		{ "arithmetic", "function run(n) { total = 0; for (i = 0; i < n; i = i + 1) { total = total + (i * 3 + 1) % 7 - ((i >> 2) & 5); } return total; } return run(iterations);", "run", nullptr },
+		{ "globals", "{ total = 0; i = 0; while (i < iterations) { total = total + (i & 15) * 2; i = i + 1; } } return total;", nullptr, nullptr },
+		{ "calls", "function mix(a, b) { return (a ~ b) + 1; } { total = 0; for (i = 0; i < iterations; i = i + 1) total = mix(total, i) & 0xFFFF; } return total;", "mix", nullptr },
+		{ "strings", "function run(n, name) { count = 0; for (i = 0; i < n; i = i + 1) { if (name == \"mov\" || name == \"push\") count = count + 1; } return count; } return run(iterations, \"push\");", nullptr, nullptr },
+		{ "bailouts", "function safe(a, b) { return a + (a / b); } { total = 0; for (i = 0; i < iterations; i = i + 1) total = safe(total, (i & 7) + 1) & 0xFFFF; } return safe(total, 0);", "safe", "attempt to / by zero" }
+	};
+
+	std::printf("Script benchmark: %lld iterations\n", static_cast<long long>(iterations));
+
+	int failed = 0;
+	for (const auto& [name, source, jitted, error] : benchmarks)
 	{
-		std::printf("Please try to run MagicalMadness.exe with the file you'd like to analyze!\n");
-		std::printf("Running in test mode (no file given).\n");
+		try
+		{
+			script_t script{ source };
 
-		std::unique_ptr<interface_t> window = std::make_unique<interface_t>("Magical Madness");
+			// Warmed up here since run() is only called once, a function that should compile but doesn't would just time the VM twice
+			if (jitted && jit::available)
+			{
+				const auto& functions = script.get_chunk().functions;
+				auto function = std::find_if(functions.begin(), functions.end(), [&](const auto& function) { return function->name == jitted; });
 
-		loader_output_t placeholder{};
+				const jit_code_t* code = nullptr;
+				for (std::uint32_t i = 0; function != functions.end() && !code && i <= jit::hot_calls; ++i)
+					code = jit::hot_code(**function);
 
-		while (!window->messenger())
+				if (!code)
+				{
+					std::printf("\t%-12s failed: the JIT didn't compile %s\n", name, jitted);
+					++failed;
+					continue;
+				}
+			}
+
+			auto time = [&](auto&& run)
+			{
+				std::shared_ptr<environment_t> environment = std::make_shared<environment_t>();
+				environment->assign("iterations", value_t{ iterations });
+
+				std::int64_t result = -1;
+				std::string thrown{};
+				auto start = std::chrono::steady_clock::now();
+				try
+				{
+					value_t value = run(environment);
+					result = value.type == RUNTIME_INTEGER ? value.integer : -1;
+				}
+				catch (std::exception& err)
+				{
+					thrown = err.what();
+				}
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				return std::make_tuple(ms, result, thrown);
+			};
+
+			auto [tree_ms, tree_result, tree_error] = time([&](std::shared_ptr<environment_t>& environment) { return script.interpret(*environment); });
+			auto run_vm = [&](std::shared_ptr<environment_t>& environment)
+			{
+				execution_state_t state{ .global_env = environment };
+				return script.run(state);
+			};
+
+			jit::enabled = false;
+			auto [vm_ms, vm_result, vm_error] = time(run_vm);
+			jit::enabled = true;
+			auto [jit_ms, jit_result, jit_error] = time(run_vm); // hot functions get compiled while this runs
+
+			bool same = tree_result == vm_result && vm_result == jit_result && tree_error == vm_error && vm_error == jit_error;
+			bool expected = tree_error == (error ? error : "");
+			std::printf("\t%-12s tree: %9.3fms (%6.1fns/iteration)  vm: %9.3fms (%6.1fns/iteration)  vm+jit: %9.3fms (%6.1fns/iteration)%s%s%s\n", name,
+				tree_ms, tree_ms * 1000000.0 / iterations, vm_ms, vm_ms * 1000000.0 / iterations, jit_ms, jit_ms * 1000000.0 / iterations,
+				same ? "" : "  RESULTS DIFFER", expected ? "" : "  UNEXPECTED ERROR: ", expected ? "" : tree_error.empty() ? "none" : tree_error.c_str());
+			failed += !same || !expected;
+		}
+		catch (std::exception& err)
 		{
-			window->render(placeholder);
+			std::printf("\t%-12s failed: %s\n", name, err.what());
+			++failed;
 		}
 	}
-	else
+
+	return failed ? 1 : 0;
+}
+
+// MagicalMadness.exe --batch <file to analyze | synthetic instruction count> <script files...>
+// Runs the scripts against the analysis one after another without the UI, variables carry over like in the Scripting Suite.
+// Compiled scripts are kept in script_cache/, running the same library again skips lexing, parsing & compiling.
+int run_batch(int argc, char* argv[])
+{
+	if (argc < 4)
 	{
-		std::unique_ptr<interface_t> window = std::make_unique<interface_t>("Magical Madness");
+		std::printf("Usage: --batch <file to analyze | synthetic instruction count> <script files...>\n");
+		return 1;
+	}
 
-		loader_t executable{ argv[1] };
-		loader_output_t output{};
+	loader_output_t output{};
+	if (!analyze_argument(argv[2], output))
+		return 1;
 
-		executable.analyze(output);
+	thread_pool_t pool{};
+	analysis_database_t database{ output };
+	script_runner_t runner{ pool };
+	runner.set_cache_directory("script_cache");
 
-		while (!window->messenger())
+	int failed = 0;
+	for (int i = 3; i < argc; ++i)
+	{
+		std::ifstream file{ argv[i], std::ios::binary };
+		if (!file)
 		{
-			window->render(output);
+			std::printf("%s: can't be opened\n", argv[i]);
+			++failed;
+			continue;
 		}
+
+		std::string source{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+		runner.start(source, database, {});
+		while (runner.poll())
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+
+		std::printf("%s: %s\n", argv[i], runner.get_status().c_str());
+		failed += runner.has_failed();
+	}
+
+	std::printf("%zu scripts loaded from script_cache, %zu compiled, %d failed\n", runner.get_cache().loaded, runner.get_cache().compiled, failed);
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::printf("Welcome to Magical Madness!\n");
+
+	if (argc >= 2 && std::string_view{ argv[1] } == "--headless-bench")
+		return run_headless_benchmark(argc, argv);
+
+	if (argc >= 2 && std::string_view{ argv[1] } == "--script-bench")
+		return run_script_benchmark(argc, argv);
+
+	if (argc >= 2 && std::string_view{ argv[1] } == "--batch")
+		return run_batch(argc, argv);
+
+#ifndef _WIN32
+	std::printf("Only --headless-bench, --script-bench and --batch are supported on this platform.\n");
+	return 1;
+#else
+	
+	// If any errors occur this will be the backbone which catches those errors and gives you a chance to see what went wrong (will make bug hunting MUCH easier)
+	SetUnhandledExceptionFilter(reinterpret_cast<LPTOP_LEVEL_EXCEPTION_FILTER>(&custom_exception_handler));
+
+	create_console();
+
+	// Every file given on the command line becomes a tab, more can be opened from the workspace window.
+	workspace_t workspace{ [](const std::string& path) { return std::make_unique<loader_t>(path); } };
+
+	if (argc < 2) // First argument is it's own file path.
+	{
+		std::printf("Please try to run MagicalMadness.exe with the file(s) you'd like to analyze!\n");
+		std::printf("Running in test mode (no file given).\n");
+	}
+
+	for (int i = 1; i < argc; ++i)
+		workspace.open(argv[i]);
+
+	std::unique_ptr<interface_t> window = std::make_unique<interface_t>("Magical Madness");
+
+	while (!window->messenger())
+	{
+		window->render(workspace);
 	}
 	
 	std::printf("Shutting down!\n");
 
 	return 1;
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "LL_graphical.hpp"
+#include "profiler/profiler.hpp"
 
 #include "dependencies/imgui/imgui.h"
 #include "dependencies/imgui/imgui_impl_win32.h"
@@ -14,8 +15,7 @@ LL_graphical_t::~LL_graphical_t()
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
 
-	if (this->p_render_target)
-		this->p_render_target->Release();
+	this->release_render_target();
 
 	if (this->p_swapchain)
 		this->p_swapchain->Release();
@@ -80,9 +80,60 @@ void LL_graphical_t::create_render_target()
 	p_backbuffer->Release();
 }
 
+void LL_graphical_t::release_render_target()
+{
+	if (this->p_render_target)
+	{
+		this->p_render_target->Release();
+		this->p_render_target = nullptr;
+	}
+}
+
+void LL_graphical_t::queue_resize(UINT width, UINT height)
+{
+	this->pending_width = width;
+	this->pending_height = height;
+	this->resize_pending = true;
+}
+
+// Only the back buffers and their view are rebuilt, the device, context and everything ImGui created stay alive.
+void LL_graphical_t::apply_pending_resize()
+{
+	if (!this->resize_pending || !this->p_swapchain)
+		return;
+
+	this->resize_pending = false;
+
+	DXGI_SWAP_CHAIN_DESC current{};
+	this->p_swapchain->GetDesc(&current);
+	if (current.BufferDesc.Width == this->pending_width && current.BufferDesc.Height == this->pending_height)
+		return; // Moving between viewports/monitors sends WM_SIZE without a real size change
+
+	// Every reference to the back buffers must be gone before ResizeBuffers, including the one bound to the context.
+	this->p_context->OMSetRenderTargets(0, nullptr, nullptr);
+	this->release_render_target();
+
+	HRESULT res = this->p_swapchain->ResizeBuffers(0, this->pending_width, this->pending_height, DXGI_FORMAT_UNKNOWN, current.Flags); // 0 & UNKNOWN keep the current buffer count & format
+	if (res != S_OK)
+		std::printf("Error resizing swap chain! 0x%p\n", res);
+
+	this->create_render_target();
+}
+
+void LL_graphical_t::begin_frame()
+{
+	this->apply_pending_resize();
+}
+
 void LL_graphical_t::internal_render()
 {
+	PROFILE_SCOPE("LL_graphical_t::internal_render");
+	profiler::phase_timer_t phase{};
+
+	phase.next("ImGui::Render");
 	ImGui::Render();
+
+	phase.next("ImGui_ImplDX11_RenderDrawData");
 	const float clear_color_with_alpha[4] = {0.f, 0.f, 0.f, 1.f};
 	this->p_context->OMSetRenderTargets(1, &this->p_render_target, NULL);
 	this->p_context->ClearRenderTargetView(this->p_render_target, clear_color_with_alpha);
@@ -91,10 +142,12 @@ void LL_graphical_t::internal_render()
 	// Update and Render additional Platform Windows
 	if (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 	{
+		phase.next("ImGui::RenderPlatformWindowsDefault");
 		ImGui::UpdatePlatformWindows();
 		ImGui::RenderPlatformWindowsDefault();
 	}
 
+	phase.next("IDXGISwapChain::Present");
 	this->p_swapchain->Present(0, 0); // Present without vsync (1,0) = vsync
 }
 
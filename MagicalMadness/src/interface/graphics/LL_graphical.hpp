@@ -15,13 +15,22 @@ private:
 	ID3D11RenderTargetView* p_render_target = nullptr;
 	IDXGISwapChain* p_swapchain = nullptr;
 
+	// Latest size from WM_SIZE, applied at the start of the next frame. Drag resizing spams WM_SIZE so only the last one is kept.
+	UINT pending_width = 0;
+	UINT pending_height = 0;
+	bool resize_pending = false;
+
 	void create_device_and_swapchain();
 	void create_render_target();
+	void release_render_target();
 	void initialize_imgui();
+	void apply_pending_resize();
+	void begin_frame();
 	void internal_render();
 public:
 	LL_graphical_t() = default;
 	~LL_graphical_t();
 
 	void setup(HWND hwnd);
+	void queue_resize(UINT width, UINT height);
 };
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef ZYDIS_STATIC_BUILD
+#define ZYDIS_STATIC_BUILD
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "headless.hpp"
+#include "profiler/profiler.hpp"
+#include "dependencies/imgui/imgui.h"
+#include <Zydis/Zydis.h>
+
+headless_t::headless_t(float width, float height)
+{
+	IMGUI_CHECKVERSION();
+	this->context = ImGui::CreateContext();
+	ImGui::SetCurrentContext(this->context);
+	ImGui::StyleColorsDark();
+
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr; // don't let benchmark runs move the real layout around
+	io.DisplaySize = { width, height };
+	io.DeltaTime = 1.f / 60.f;
+	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable; // same as LL_graphical_t minus viewports, those need a platform backend
+
+	// Normally the renderer backend builds the font atlas & uploads it, here it's only built.
+	unsigned char* pixels = nullptr;
+	int atlas_width = 0, atlas_height = 0;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &atlas_width, &atlas_height);
+	io.Fonts->SetTexID(nullptr);
+
+	this->views->open_sections = true;
+}
+
+headless_t::~headless_t()
+{
+	ImGui::DestroyContext(this->context);
+}
+
+headless_stats_t headless_t::run(const loader_output_t& information, std::uint32_t frames)
+{
+	using frame_clock_t = std::chrono::steady_clock;
+
+	ImGui::SetCurrentContext(this->context);
+
+	headless_stats_t stats{};
+	std::vector<double> frame_times{};
+	frame_times.reserve(frames);
+
+	for (std::uint32_t i = 0; i < frames; ++i)
+	{
+		frame_clock_t::time_point start = frame_clock_t::now();
+
+		profiler::begin_frame();
+		{
+			PROFILE_SCOPE("headless_t::run (frame)");
+
+			ImGui::NewFrame();
+			this->views->render(information);
+			ImGui::Render();
+		}
+
+		frame_times.push_back(std::chrono::duration<double, std::milli>(frame_clock_t::now() - start).count());
+
+		ImDrawData* draw_data = ImGui::GetDrawData();
+		stats.vertices = draw_data ? draw_data->TotalVtxCount : 0;
+		stats.indices = draw_data ? draw_data->TotalIdxCount : 0;
+	}
+
+	if (frame_times.empty())
+		return stats;
+
+	stats.frames = frames;
+	for (double time : frame_times)
+		stats.average_ms += time;
+	stats.average_ms /= frame_times.size();
+
+	std::sort(frame_times.begin(), frame_times.end());
+	stats.min_ms = frame_times.front();
+	stats.max_ms = frame_times.back();
+	stats.median_ms = frame_times[frame_times.size() / 2];
+	stats.p99_ms = frame_times[std::min(frame_times.size() - 1, frame_times.size() * 99 / 100)];
+
+	return stats;
+}
+
+void make_synthetic_output(loader_output_t& output, std::uint32_t instruction_count)
+{
+	struct template_t { ZydisMnemonic mnemonic; const char* text; ZydisRegister reg; bool has_constant; };
+	const template_t templates[] = {
+		{ ZYDIS_MNEMONIC_PUSH, "push ebp", ZYDIS_REGISTER_EBP, false },
+		{ ZYDIS_MNEMONIC_MOV, "mov ebp, esp", ZYDIS_REGISTER_EBP, false },
+		{ ZYDIS_MNEMONIC_MOV, "mov eax, dword ptr [ebp+0x08]", ZYDIS_REGISTER_EAX, true },
+		{ ZYDIS_MNEMONIC_ADD, "add eax, 0x401000", ZYDIS_REGISTER_EAX, true },
+		{ ZYDIS_MNEMONIC_CALL, "call 0x00402000", ZYDIS_REGISTER_NONE, true },
+		{ ZYDIS_MNEMONIC_POP, "pop ebp", ZYDIS_REGISTER_EBP, false },
+		{ ZYDIS_MNEMONIC_RET, "ret", ZYDIS_REGISTER_NONE, false }
+	};
+
+	output.output = "Synthetic listing for the headless benchmark.\n";
+	output.successful = true;
+
+	std::string& text = output.disassembled_code[".text"];
+	std::vector<instruction_t>& instructions = output.instructions[".text"];
+	text.reserve(static_cast<std::size_t>(instruction_count) * 40);
+	instructions.reserve(instruction_count);
+
+	char line[100]{ 0 };
+	std::uint32_t address = 0x00401000;
+	for (std::uint32_t i = 0; i < instruction_count; ++i)
+	{
+		const template_t& current = templates[i % std::size(templates)];
+		int written = std::snprintf(line, sizeof(line), "[0x%08X]: %s\n", address, current.text);
+
+		instruction_t& record = instructions.emplace_back();
+		record.address = address;
+		record.text_offset = static_cast<std::uint32_t>(text.size());
+		record.text_length = static_cast<std::uint16_t>(written - 1);
+		record.mnemonic = static_cast<std::uint16_t>(current.mnemonic);
+		record.length = 3;
+		if (current.reg != ZYDIS_REGISTER_NONE)
+			record.registers[record.register_count++] = static_cast<std::uint16_t>(current.reg);
+		if (current.has_constant)
+			record.constants[record.constant_count++] = 0x401000;
+
+		text += line;
+		address += record.length;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+
+#include "interface/views.hpp"
+
+struct ImGuiContext;
+
+struct headless_stats_t
+{
+	std::uint32_t frames = 0;
+	double min_ms = 0.0;
+	double average_ms = 0.0;
+	double median_ms = 0.0;
+	double p99_ms = 0.0;
+	double max_ms = 0.0;
+	std::uint64_t vertices = 0;		// Draw data of the last frame, a jump here usually means a view stopped clipping
+	std::uint64_t indices = 0;
+};
+
+// Drives views_t with a bare ImGui context: no window, no platform backend, no renderer.
+// Draw data is built like normal then thrown away, so this measures exactly the CPU side of a frame and runs on machines without a GPU.
+class headless_t
+{
+private:
+	ImGuiContext* context = nullptr;
+	thread_pool_t pool{};
+	std::unique_ptr<views_t> views = std::make_unique<views_t>(this->pool);
+public:
+	headless_t(float width = 1920.f, float height = 1080.f);
+	headless_t(const headless_t&) = delete;
+	~headless_t();
+
+	headless_stats_t run(const loader_output_t& information, std::uint32_t frames);
+};
+
+// Fake listing with instruction_count instructions, lets the views be benchmarked at any scale without a binary to analyze.
+void make_synthetic_output(loader_output_t& output, std::uint32_t instruction_count);
@@ -0,0 +1,205 @@
+#include "views.hpp"
+#include "profiler/profiler.hpp"
+#include "dependencies/imgui/imgui.h"
+#include <dependencies/imgui/imgui_internal.h>
+
+#include <algorithm>
+
+void views_t::render_information(const loader_output_t& information)
+{
+	ImGui::Begin("PE Information", &this->window_open);
+		ImVec2 sz = ImGui::GetWindowSize();
+		ImGui::SetCursorPos({ sz.x / 2 - sz.x / 8, 20 });
+		ImGui::Text("Successful disassembly: %s\n", information.successful ? "yes" : "no");
+		ImGui::SetCursorPos({ 20, sz.y / 2 });
+		ImGui::TextUnformatted(information.output.c_str(), &*information.output.end());
+
+	ImGui::End();
+}
+
+void views_t::render_listing(const loader_output_t& information)
+{
+	ImGui::Begin("Disassembled Code", &this->window_open);
+
+		for (auto& [section, disassembly] : information.disassembled_code)
+		{
+			if (this->open_sections)
+				ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+
+			if (ImGui::TreeNode(section.c_str()))
+			{
+				ImGui::TextUnformatted(disassembly.c_str(), &*disassembly.end());
+				ImGui::TreePop();
+			}
+		}
+
+	ImGui::End();
+}
+
+void views_t::render_search(const loader_output_t& information)
+{
+	ImGui::Begin("Search", &this->window_open);
+
+		ImGui::SetNextItemWidth(100.f);
+		ImGui::Combo("##search_kind", &this->search_kind, search_kind_strings, IM_ARRAYSIZE(search_kind_strings));
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(-150.f);
+		bool submitted = ImGui::InputText("##search_query", this->search_query, sizeof(this->search_query), ImGuiInputTextFlags_EnterReturnsTrue);
+		ImGui::SameLine();
+		if (ImGui::Button("Search") || submitted)
+			this->search->start(information, static_cast<search_kind_t>(this->search_kind), this->search_query);
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel"))
+			this->search->cancel();
+
+		const std::vector<search_hit_t>& hits = this->search->poll();
+		if (!this->search->get_error().empty())
+			ImGui::TextColored({ 1.f, 0.3f, 0.3f, 1.f }, "%s", this->search->get_error().c_str());
+		else
+			ImGui::Text("%zu hits%s", hits.size(), this->search->is_running() ? " (searching...)" : "");
+
+		// Only the visible rows are ever formatted, so this stays fast with millions of hits.
+		ImGui::BeginChild("##search_hits");
+			ImGuiListClipper clipper{};
+			clipper.Begin(static_cast<int>(hits.size()));
+			while (clipper.Step())
+			{
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+				{
+					std::string_view section = this->search->section_name(hits[i]);
+					std::string_view line = this->search->line(hits[i]);
+					ImGui::Text("%.*s %.*s", static_cast<int>(section.size()), section.data(), static_cast<int>(line.size()), line.data());
+				}
+			}
+		ImGui::EndChild();
+
+	ImGui::End();
+}
+
+void views_t::render_scripting(const loader_output_t& information)
+{
+	ImGui::Begin("Scripting Suite", &this->window_open);
+		ImVec2 window_size = ImGui::GetWindowSize();
+
+		ImGui::Text("This all runs on a completely custom compiler.\nInsert a script below, output will show in the C++ console.\nThis compiler supports operator precedence, unary, negate, variables and native functions. (C++ invoke)\nNumbers without a decimal point are 64 bit integers so addresses stay exact, integers also have & | << >> ~ (xor, or complement in front).\nComparisons (== != < <= > >=), && ||, if/else, while, for, break, continue and functions: function Add(A, B) { return A + B; }\nEach top level line will be an output, inside blocks use print().\nExample script for computing a jump table:\n\nSomeValue = 0x401000; JumpIndex = 5; SomeValue + JumpIndex * 4;\n\nAn example for calling C++ is below (and in scripting/script_runner.cpp):\n\nHelloComputer();\n\nThe loaded binary can be queried too, e.g. count the calls to the first import:\n\nTarget = import_address(0); xref_count(Target);\nCalls = 0; for (I = first_instruction(0); I != -1; I = next_instruction(I)) { if (instruction_mnemonic(I) == \"call\") { Calls = Calls + 1; } } Calls;\n\nsee scripting/script_api.cpp for every function (sections, imports, exports, instructions, xrefs, read_u8 - read_u64).\nWork over many items can be spread over every core, the function gets each index and map_result gives back what it returned:\n\nfunction Calls(S) { C = 0; for (I = first_instruction(section_start(S)); I != -1 && instruction_address(I) < section_end(S); I = next_instruction(I)) { if (instruction_mnemonic(I) == \"call\") C = C + 1; } return C; }\nN = parallel_map(section_count(), Calls); map_result(0);\n\nStrings are joined with + (long reports are only copied once, when used), length, substring, find, hex and to_string work on them:\n\nReport = \"\"; for (I = first_instruction(0); I != -1; I = next_instruction(I)) { if (instruction_mnemonic(I) == \"call\") Report = Report + instruction_text(I) + \" | \"; } length(Report);\n\nTyped arrays (u8, u32, u64, f64) work on whole byte ranges at once, section_view and image_view read the image without copying it:\n\nData = section_view(0); array_entropy(Data); Decoded = array_xor(Data, string_to_array(\"key\")); array_find(Decoded, 0xC3, 0);\n\nScripts run in the background, one that runs too long gets stopped. Tick Profile to see which functions the time goes to.");
+		if (ImGui::InputTextMultiline("##script", &this->script_buffer[0], this->script_buffer.size(), { window_size.x - 25.f, window_size.y - 470.f }, ImGuiInputTextFlags_AllowTabInput))
+		{
+			PROFILE_SCOPE("views_t::render_scripting syntax");
+			this->script_syntax.update(this->script_buffer.c_str());
+			this->script_diagnostics = this->script_syntax.diagnostics();
+		}
+
+		// Syntax errors show while typing, the rest (undefined names and such) once it runs
+		for (std::size_t i = 0; i < this->script_diagnostics.size() && i < 5; ++i)
+			ImGui::TextColored({ 1.f, 0.4f, 0.4f, 1.f }, "Line %u: %s", this->script_diagnostics[i].line, this->script_diagnostics[i].message.c_str());
+		if (this->script_diagnostics.size() > 5)
+			ImGui::TextColored({ 1.f, 0.4f, 0.4f, 1.f }, "...and %zu more", this->script_diagnostics.size() - 5);
+
+		// Scripts run on a pool worker, a runaway one gets stopped by the time or instruction limit (or the cancel button) instead of freezing this
+		bool running = this->scripts->poll();
+		if (running)
+		{
+			if (ImGui::Button("Cancel Script"))
+				this->scripts->cancel();
+			ImGui::SameLine();
+			ImGui::Text("Running... %.1fs", this->scripts->elapsed_milliseconds() / 1000.0);
+		}
+		else if (ImGui::Button("Run Script"))
+		{
+			if (!this->database || this->database->source != &information)
+				this->database = std::make_unique<analysis_database_t>(information);
+
+			script_limits_t limits{};
+			limits.max_milliseconds = static_cast<std::uint32_t>(std::max(this->script_time_limit, 0));
+			limits.max_instructions = this->script_instruction_limit;
+			limits.profile = this->script_profile;
+			this->scripts->start(this->script_buffer.c_str(), *this->database, limits); // Buffer is kept so the script can be run again
+		}
+
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(100.f);
+		ImGui::InputInt("ms limit", &this->script_time_limit, 0);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(120.f);
+		ImGui::InputScalar("instruction limit (0 = none)", ImGuiDataType_U64, &this->script_instruction_limit);
+		ImGui::SameLine();
+		ImGui::Checkbox("Profile", &this->script_profile);
+
+		if (!running)
+		{
+			ImGui::TextUnformatted(this->scripts->get_status().c_str());
+			this->render_script_profile(this->scripts->get_profile());
+		}
+	ImGui::End();
+}
+
+void views_t::render_script_profile(const script_profile_t& profile)
+{
+	if (profile.functions.empty())
+		return;
+
+	// Slowest first, time includes what a function called, instructions are only its own
+	if (ImGui::BeginTable("##script_profile", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, { 0.f, 150.f }))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Function");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableSetupColumn("Machine code calls");
+		ImGui::TableSetupColumn("Instructions");
+		ImGui::TableSetupColumn("ms");
+		ImGui::TableHeadersRow();
+
+		for (const function_profile_t* function : profile.sorted())
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(function->name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(function->calls));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(function->compiled_calls));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(function->instructions));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", function->milliseconds);
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (ImGui::TreeNode("Instructions by opcode"))
+	{
+		for (std::size_t op = 0; op < profile.opcodes.size(); ++op)
+		{
+			if (profile.opcodes[op])
+				ImGui::Text("%-22s %llu", opcode_strings[op].c_str(), static_cast<unsigned long long>(profile.opcodes[op]));
+		}
+		ImGui::TreePop();
+	}
+}
+
+bool views_t::render(const loader_output_t& information)
+{
+	if (!this->window_open)
+		return false;
+
+	PROFILE_SCOPE("views_t::render");
+
+	ImGuiContext* ctx = ImGui::GetCurrentContext();
+
+	ctx->Style.Colors[ImGuiCol_WindowBg] = ImColor{ 53, 53, 53 };
+	ctx->Style.Colors[ImGuiCol_TitleBgActive] = ImColor{ 229, 0, 95 };
+	ctx->Style.Colors[ImGuiCol_TitleBg] = ImColor{ 104, 0, 43 };
+	ctx->Style.Colors[ImGuiCol_TitleBgCollapsed] = ImColor{ 104, 0, 43 };
+	ctx->Style.Colors[ImGuiCol_ResizeGrip] = ImColor{ 255, 73, 122 };
+	ctx->Style.Colors[ImGuiCol_ResizeGripHovered] = ImColor{ 255, 20, 75 };
+	ctx->Style.Colors[ImGuiCol_ResizeGripActive] = ImColor{ 255, 20, 75 };
+	//ctx->Style.Colors[]
+
+	this->render_information(information);
+	this->render_listing(information);
+	this->render_search(information);
+	this->render_scripting(information);
+
+	return this->window_open;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "loader/loader_output.hpp"
+#include "search/search.hpp"
+#include "scripting/script_api.hpp"
+#include "scripting/script_runner.hpp"
+#include "compiler/parser/incremental.hpp"
+#include "common/thread_pool.hpp"
+
+// Every ImGui window of the tool.
+// Knows nothing about the platform or renderer backend, so the same views are driven by interface_t (Win32 + DirectX11) and headless_t (no backend at all).
+class views_t
+{
+private:
+	std::unique_ptr<search_t> search; // background listing search
+	std::unique_ptr<analysis_database_t> database; // what scripts query, rebuilt when the document's analysis changes
+	std::unique_ptr<script_runner_t> scripts; // after database, it has to stop before the database goes away
+	bool window_open = true;
+
+	std::int32_t search_kind = SEARCH_MNEMONIC;
+	char search_query[256]{ 0 };
+	std::string script_buffer = std::string(15000, '\0'); // Script box can hold 15k chars
+	std::int32_t script_time_limit = 10000; // ms, 0 = none
+	std::uint64_t script_instruction_limit = 0; // 0 = none
+	bool script_profile = false;
+	incremental_parser_t script_syntax{}; // checked as it's typed, only what the edit touched gets lexed & parsed again
+	std::vector<script_diagnostic_t> script_diagnostics{};
+
+	void render_information(const loader_output_t& information);
+	void render_listing(const loader_output_t& information);
+	void render_search(const loader_output_t& information);
+	void render_scripting(const loader_output_t& information);
+	void render_script_profile(const script_profile_t& profile);
+public:
+	bool open_sections = false; // Expand every listing section the first time it's drawn (the headless benchmark wants the worst case)
+
+	views_t(thread_pool_t& pool) : search{ std::make_unique<search_t>(pool) }, scripts{ std::make_unique<script_runner_t>(pool) } {};
+	views_t(const views_t&) = delete;
+
+	bool render(const loader_output_t& information); // Must be called between ImGui::NewFrame and ImGui::Render, returns false once the user closed the tool
+};
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "loader.hpp"
 #include "disassembler/disassembler.hpp"
+#include "profiler/profiler.hpp"
 
 // Disclaimer:
 // This code uses LOTS of undocumented windows internals. They won't be just there documented for you, it took time to reverse engineering the
@@ -79,6 +80,8 @@ void append_to_output(std::string& output, const char* formatting, auto... args)
 // A complete guide to the internals of the windows PE format: http://www.csn.ul.ie/~caolan/pub/winresdump/winresdump/doc/pefile2.html
 void loader_t::analyze(loader_output_t& loader_output)
 {
+	PROFILE_SCOPE("loader_t::analyze");
+	profiler::phase_timer_t phase{};
 	std::string& output = loader_output.output;
 
 	append_to_output(output, "Analyzing: %s\n", this->file_path.substr(this->file_path.find_last_of("\\") + 1).c_str());
@@ -94,6 +97,8 @@ void loader_t::analyze(loader_output_t& loader_output)
 	// "allows the process to work efficiently with a large data file, such as a database, without having to map the whole file into memory"
 	// Also: https://learn.microsoft.com/en-us/windows/win32/memory/creating-a-file-mapping-object
 	
+	phase.next("loader_t::analyze (map)");
+
 	// Remove SEC_IMAGE if you want to be able to load images which are maybe scrambled up a bit (such as hiding section names)
 	this->h_map = CreateFileMapping(this->h_file, NULL, PAGE_READONLY | SEC_IMAGE, NULL, NULL, NULL);
 	
@@ -102,6 +107,7 @@ void loader_t::analyze(loader_output_t& loader_output)
 
 	if (base_address != NULL)
 	{
+		phase.next("loader_t::analyze (headers)");
 		append_to_output(output, "Successfully mapped process into address: 0x%p\n", base_address);
 		PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(base_address);
 
@@ -153,6 +159,11 @@ void loader_t::analyze(loader_output_t& loader_output)
 
 		append_to_output(output, "Executable information:\n\tImage Base: 0x%p\n\tEntry Point: 0x%p\n", image_base, entry_point);
 
+		loader_output.image_base = image_base;
+		loader_output.mapped_base = reinterpret_cast<std::uint32_t>(base_address);
+		loader_output.image = reinterpret_cast<const std::uint8_t*>(base_address);
+		loader_output.image_size = pe_header->OptionalHeader.SizeOfImage;
+
 		append_to_output(output, "Sections:\n");
 		PIMAGE_SECTION_HEADER first_section = IMAGE_FIRST_SECTION(pe_header);
 		for (std::uint32_t i = 0; i < pe_header->FileHeader.NumberOfSections; ++i)
@@ -176,7 +187,14 @@ void loader_t::analyze(loader_output_t& loader_output)
 
 		std::uint32_t base_addy = reinterpret_cast<std::uint32_t>(base_address); // lots of this code below needs this as a number
 
+		for (const section_t& section : this->sections)
+		{
+			loader_output.sections.push_back({ section.section_name.substr(0, IMAGE_SIZEOF_SHORT_NAME).c_str(), base_addy + section.start_address, base_addy + section.end_address,
+				section.is_code, section.is_data, section.has_read, section.has_write, section.has_execute });
+		}
+
 
+		phase.next("loader_t::analyze (exports)");
 		PIMAGE_EXPORT_DIRECTORY export_directory = this->get_image_directory_address<PIMAGE_EXPORT_DIRECTORY>(pe_header, IMAGE_DIRECTORY_ENTRY_EXPORT);
 
 		if (export_directory)
@@ -191,6 +209,7 @@ void loader_t::analyze(loader_output_t& loader_output)
 			for (std::uint32_t i = 0; i < export_directory->NumberOfNames; ++i)
 			{
 				append_to_output(output, "\tLocated export: %s - 0x%p\n", reinterpret_cast<const char*>(base_addy + export_names[i]), export_functions[export_ordinals[i]]);
+				loader_output.exports.push_back({ reinterpret_cast<const char*>(base_addy + export_names[i]), base_addy + export_functions[export_ordinals[i]] });
 			}
 		}
 		else
@@ -198,6 +217,7 @@ void loader_t::analyze(loader_output_t& loader_output)
 			append_to_output(output, "no exports\n");
 		}
 
+		phase.next("loader_t::analyze (imports)");
 		PIMAGE_IMPORT_DESCRIPTOR current_import = this->get_image_directory_address<PIMAGE_IMPORT_DESCRIPTOR>(pe_header, IMAGE_DIRECTORY_ENTRY_IMPORT);
 
 		if (current_import)
@@ -205,7 +225,8 @@ void loader_t::analyze(loader_output_t& loader_output)
 			append_to_output(output, "Imports:\n");
 			while (current_import->Name)
 			{
-				append_to_output(output, "[ %s ]\n", reinterpret_cast<const char*>(base_addy + current_import->Name));
+				const char* module_name = reinterpret_cast<const char*>(base_addy + current_import->Name);
+				append_to_output(output, "[ %s ]\n", module_name);
 
 				PIMAGE_THUNK_DATA32 current_thunk = reinterpret_cast<PIMAGE_THUNK_DATA32>(base_addy + current_import->FirstThunk);
 				while (current_thunk->u1.AddressOfData)
@@ -214,11 +235,13 @@ void loader_t::analyze(loader_output_t& loader_output)
 					if (current_thunk->u1.AddressOfData & IMAGE_ORDINAL_FLAG32)
 					{
 						append_to_output(output, "\tOrdinal: %d\n", current_thunk->u1.AddressOfData ^ IMAGE_ORDINAL_FLAG32);
+						loader_output.imports.push_back({ module_name, "", current_thunk->u1.AddressOfData ^ IMAGE_ORDINAL_FLAG32, reinterpret_cast<std::uint32_t>(current_thunk) });
 					}
 					else
 					{
 						PIMAGE_IMPORT_BY_NAME import_name = reinterpret_cast<PIMAGE_IMPORT_BY_NAME>(base_addy + current_thunk->u1.AddressOfData);
 						append_to_output(output, "\t%s\n", import_name->Name);
+						loader_output.imports.push_back({ module_name, reinterpret_cast<const char*>(import_name->Name), 0, reinterpret_cast<std::uint32_t>(current_thunk) });
 					}
 
 
@@ -234,15 +257,9 @@ void loader_t::analyze(loader_output_t& loader_output)
 		}
 
 
+		phase.next("loader_t::analyze (disassembly)");
 		extract_sections_from_PE(pe_header);
-		for (const section_t& section : this->sections)
-		{
-			if (section.has_read && section.is_code)
-			{
-				disassembler_t disassembler{ section };
-				loader_output.disassembled_code[section.section_name] = disassembler.disassemble(reinterpret_cast<std::uint32_t>(this->map_base_address));
-			}
-		}
+		this->disassemble(loader_output);
 	}
 	else
 	{
@@ -254,4 +271,21 @@ void loader_t::analyze(loader_output_t& loader_output)
 
 	loader_output.successful = true;
 	return;
+}
+
+// Can be re-run at any point after analyze, the mapping stays alive until the loader is destroyed.
+void loader_t::disassemble(loader_output_t& loader_output)
+{
+	if (this->map_base_address == nullptr)
+		return;
+
+	for (const section_t& section : this->sections)
+	{
+		if (section.has_read && section.is_code)
+		{
+			disassembler_t disassembler{ section };
+			loader_output.disassembled_code[section.section_name] = std::move(disassembler.disassemble(reinterpret_cast<std::uint32_t>(this->map_base_address)));
+			loader_output.instructions[section.section_name] = std::move(disassembler.get_instructions());
+		}
+	}
 }
\ No newline at end of file
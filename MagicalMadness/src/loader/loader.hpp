@@ -5,6 +5,9 @@
 #include <vector>
 #include <unordered_map>
 
+#include "loader_output.hpp"
+#include "workspace/document_source.hpp"
+
 // The loader will be responsible for opening the file and reading PE information about it.
 
 struct section_t
@@ -29,17 +32,7 @@ struct section_t
 	};
 };
 
-struct loader_output_t
-{
-public:
-	loader_output_t() = default;
-	loader_output_t(const loader_output_t&) = delete; // copying this struct is dangerous cause it's very big.
-	std::string output{};
-	std::uint8_t successful = false;
-	std::unordered_map<std::string, std::string> disassembled_code{};
-};
-
-class loader_t
+class loader_t : public document_source_t
 {
 private:
 	std::string file_path{};
@@ -53,8 +46,10 @@ private:
 	void extract_sections_from_PE(PIMAGE_NT_HEADERS32 pe_header);
 public:
 	loader_t(const std::string& file_path) : file_path{ file_path } {};
+	loader_t(const loader_t&) = delete; // owns the file mapping
 	~loader_t();
 
-	void analyze(loader_output_t& loader_output);
+	void analyze(loader_output_t& loader_output) override;
+	void disassemble(loader_output_t& loader_output) override;
 	void testing();
 };
\ No newline at end of file
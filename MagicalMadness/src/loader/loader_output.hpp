@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "disassembler/instruction.hpp"
+
+// Structured copies of what the loader prints, for scripts (see scripting/script_api.hpp).
+// Every address is a mapped address, the same ones the listing shows.
+struct section_info_t
+{
+	std::string name{};
+	std::uint32_t start_address = 0;
+	std::uint32_t end_address = 0;
+	std::uint8_t is_code = false, is_data = false, has_read = false, has_write = false, has_execute = false;
+};
+
+struct import_t
+{
+	std::string module{};
+	std::string name{};					// Empty when imported by ordinal
+	std::uint32_t ordinal = 0;
+	std::uint32_t thunk_address = 0;	// Its slot in the import address table
+};
+
+struct export_t
+{
+	std::string name{};
+	std::uint32_t address = 0;
+};
+
+// Everything analysis hands to the interface. Kept free of Windows headers so the views can be built (and benchmarked) anywhere.
+struct loader_output_t
+{
+public:
+	loader_output_t() = default;
+	loader_output_t(const loader_output_t&) = delete; // copying this struct is dangerous cause it's very big.
+	std::string output{};
+	std::uint8_t successful = false;
+	std::unordered_map<std::string, std::string> disassembled_code{};
+	std::unordered_map<std::string, std::vector<instruction_t>> instructions{}; // Same keys as disassembled_code, instruction_t::text_offset points into those strings
+
+	std::uint32_t image_base = 0;			// Preferred base from the PE header, absolute addresses inside the code are based on this
+	std::uint32_t mapped_base = 0;			// Where the image was mapped, every address above and below is based on this
+	const std::uint8_t* image = nullptr;	// The mapped image itself, owned by the loader (which lives as long as the document does)
+	std::uint32_t image_size = 0;
+
+	std::vector<section_info_t> sections{};
+	std::vector<import_t> imports{};
+	std::vector<export_t> exports{};
+};
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "profiler.hpp"
+#include "dependencies/imgui/imgui.h"
+
+using namespace profiler;
+
+// Time spent in one phase, per frame and per call.
+struct phase_t
+{
+	const char* name = nullptr;
+	float frame_ms[frame_history]{ 0 };	// Total time spent in this phase each frame (ring, indexed like frame_times)
+	float current_frame_ms = 0.f;
+	float last_ms = 0.f;
+	float max_ms = 0.f;
+	double total_ms = 0.0;
+	std::uint64_t calls = 0;
+};
+
+struct profiler_state_t
+{
+	std::mutex mutex{};
+
+	timer_clock_t::time_point epoch = timer_clock_t::now();
+	timer_clock_t::time_point frame_start = epoch;
+	std::uint64_t frame = 0;
+	float frame_times[frame_history]{ 0 };
+
+	std::vector<event_t> events = std::vector<event_t>(event_capacity);
+	std::size_t event_head = 0;		// Next slot to write
+	std::size_t event_count = 0;
+
+	std::vector<phase_t> phases{};	// Few enough that a linear search beats hashing
+};
+
+static profiler_state_t& state()
+{
+	static profiler_state_t instance{};
+	return instance;
+}
+
+static std::uint32_t current_thread()
+{
+	static std::atomic<std::uint32_t> next_thread = 0;
+	thread_local std::uint32_t id = next_thread++;
+	return id;
+}
+
+static float to_ms(timer_clock_t::duration duration)
+{
+	return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+scoped_timer_t::~scoped_timer_t()
+{
+	record(this->name, this->start, timer_clock_t::now());
+}
+
+phase_timer_t::~phase_timer_t()
+{
+	this->next(nullptr);
+}
+
+void phase_timer_t::next(const char* phase_name)
+{
+	timer_clock_t::time_point now = timer_clock_t::now();
+	if (this->name)
+		record(this->name, this->start, now);
+
+	this->name = phase_name;
+	this->start = now;
+}
+
+void profiler::record(const char* name, timer_clock_t::time_point start, timer_clock_t::time_point end)
+{
+	profiler_state_t& profiler = state();
+	std::uint32_t thread = current_thread();
+	float elapsed = to_ms(end - start);
+
+	std::lock_guard lock{ profiler.mutex };
+
+	profiler.events[profiler.event_head] = { name, thread, profiler.frame, start, end - start };
+	profiler.event_head = (profiler.event_head + 1) % event_capacity;
+	profiler.event_count = std::min(profiler.event_count + 1, event_capacity);
+
+	auto phase = std::find_if(profiler.phases.begin(), profiler.phases.end(), [name](const phase_t& phase) { return phase.name == name; });
+	if (phase == profiler.phases.end())
+	{
+		phase = profiler.phases.emplace(profiler.phases.end());
+		phase->name = name;
+	}
+
+	phase->current_frame_ms += elapsed;
+	phase->last_ms = elapsed;
+	phase->max_ms = std::max(phase->max_ms, elapsed);
+	phase->total_ms += elapsed;
+	++phase->calls;
+}
+
+// Closes the previous frame: its length and every phase's share of it go into the history rings.
+void profiler::begin_frame()
+{
+	profiler_state_t& profiler = state();
+	timer_clock_t::time_point now = timer_clock_t::now();
+
+	std::lock_guard lock{ profiler.mutex };
+
+	std::size_t slot = profiler.frame % frame_history;
+	profiler.frame_times[slot] = to_ms(now - profiler.frame_start);
+	for (phase_t& phase : profiler.phases)
+	{
+		phase.frame_ms[slot] = phase.current_frame_ms;
+		phase.current_frame_ms = 0.f;
+	}
+
+	profiler.frame_start = now;
+	++profiler.frame;
+}
+
+void profiler::render_overlay(bool* open)
+{
+	if (!*open)
+		return;
+
+	profiler_state_t& profiler = state();
+	bool dump_requested = false;
+
+	std::unique_lock lock{ profiler.mutex };
+
+	// Oldest frame first so graphs scroll from right to left
+	int offset = static_cast<int>(profiler.frame % frame_history);
+	int count = static_cast<int>(std::min<std::uint64_t>(profiler.frame, frame_history));
+	if (count < static_cast<int>(frame_history))
+		offset = 0;
+
+	ImGui::Begin("Profiler", open);
+
+		float average = 0.f, worst = 0.f;
+		for (int i = 0; i < count; ++i)
+		{
+			average += profiler.frame_times[i];
+			worst = std::max(worst, profiler.frame_times[i]);
+		}
+		average = count ? average / count : 0.f;
+
+		char overlay[64]{ 0 };
+		std::snprintf(overlay, sizeof(overlay), "avg %.2fms (%.0f fps) | worst %.2fms", average, average > 0.f ? 1000.f / average : 0.f, worst);
+		ImGui::PlotHistogram("Frame", profiler.frame_times, count, offset, overlay, 0.f, std::max(worst, 16.7f), { -1.f, 80.f });
+
+		dump_requested = ImGui::Button("Dump Chrome trace");
+
+		if (ImGui::BeginTable("##phases", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable))
+		{
+			ImGui::TableSetupColumn("Phase");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Last (ms)");
+			ImGui::TableSetupColumn("Avg (ms)");
+			ImGui::TableSetupColumn("Max (ms)");
+			ImGui::TableSetupColumn("Per frame", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableHeadersRow();
+
+			for (const phase_t& phase : profiler.phases)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(phase.name);
+				ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(phase.calls));
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", phase.last_ms);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", phase.calls ? static_cast<float>(phase.total_ms / phase.calls) : 0.f);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", phase.max_ms);
+				ImGui::TableNextColumn();
+				ImGui::PushID(phase.name);
+				ImGui::PlotHistogram("##frame_ms", phase.frame_ms, count, offset, nullptr, 0.f, FLT_MAX, { -1.f, 20.f });
+				ImGui::PopID();
+			}
+
+			ImGui::EndTable();
+		}
+
+	ImGui::End();
+
+	lock.unlock(); // dumping takes the lock itself
+	if (dump_requested)
+		std::printf(dump_chrome_trace("magical_madness_trace.json") ? "Wrote magical_madness_trace.json\n" : "Failed to write magical_madness_trace.json\n");
+}
+
+// Chrome "Trace Event Format", every event is written as a complete ("X") event.
+bool profiler::dump_chrome_trace(const std::string& path)
+{
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	profiler_state_t& profiler = state();
+	std::lock_guard lock{ profiler.mutex };
+
+	file << "{\"traceEvents\":[\n";
+
+	std::size_t first = (profiler.event_head + event_capacity - profiler.event_count) % event_capacity;
+	for (std::size_t i = 0; i < profiler.event_count; ++i)
+	{
+		const event_t& event = profiler.events[(first + i) % event_capacity];
+		double start_us = std::chrono::duration<double, std::micro>(event.start - profiler.epoch).count();
+		double duration_us = std::chrono::duration<double, std::micro>(event.duration).count();
+
+		char line[256];
+		std::snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}\n",
+			i ? "," : "", event.name, event.thread, start_us, duration_us, static_cast<unsigned long long>(event.frame));
+		file << line;
+	}
+
+	file << "]}\n";
+	file.close();
+
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Tiny built in instrumentation.
+// Wrap any block in PROFILE_SCOPE("name") and it shows up in the profiler overlay (F3) and in Chrome trace dumps (chrome://tracing or ui.perfetto.dev).
+// Names must be string literals, phases are keyed by pointer.
+namespace profiler
+{
+	using timer_clock_t = std::chrono::steady_clock;
+
+	constexpr std::size_t event_capacity = 1 << 16;	// Raw events kept for trace dumps (ring buffer, oldest get overwritten)
+	constexpr std::size_t frame_history = 240;		// Frames kept for the overlay graphs
+
+	struct event_t
+	{
+		const char* name = nullptr;
+		std::uint32_t thread = 0;
+		std::uint64_t frame = 0;
+		timer_clock_t::time_point start{};
+		timer_clock_t::duration duration{};
+	};
+
+	class scoped_timer_t
+	{
+	private:
+		const char* name;
+		timer_clock_t::time_point start;
+	public:
+		scoped_timer_t(const char* name) : name{ name }, start{ timer_clock_t::now() } {};
+		scoped_timer_t(const scoped_timer_t&) = delete;
+		~scoped_timer_t();
+	};
+
+	// Times consecutive phases of one function without wrapping each phase in its own block.
+	class phase_timer_t
+	{
+	private:
+		const char* name = nullptr;
+		timer_clock_t::time_point start{};
+	public:
+		phase_timer_t() = default;
+		phase_timer_t(const phase_timer_t&) = delete;
+		~phase_timer_t();
+
+		void next(const char* phase_name); // Ends the running phase (if any) and starts timing phase_name
+	};
+
+	void record(const char* name, timer_clock_t::time_point start, timer_clock_t::time_point end);
+	void begin_frame();		// Call once at the very start of every frame
+	void render_overlay(bool* open);
+	bool dump_chrome_trace(const std::string& path);
+}
+
+#define PROFILE_CONCAT_INTERNAL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INTERNAL(a, b)
+#define PROFILE_SCOPE(name) profiler::scoped_timer_t PROFILE_CONCAT(profile_scope_, __LINE__){ name }
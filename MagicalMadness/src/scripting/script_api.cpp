@@ -0,0 +1,459 @@
+#ifndef ZYDIS_STATIC_BUILD
+#define ZYDIS_STATIC_BUILD
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+
+#include "script_api.hpp"
+#include "script_arrays.hpp"
+#include "profiler/profiler.hpp"
+#include "compiler/interpreter/include/native.hpp"
+#include "compiler/interpreter/include/vm.hpp"
+#include <Zydis/Zydis.h>
+#include <stdexcept>
+
+static const std::vector<std::int64_t> no_xrefs{};
+
+analysis_database_t::analysis_database_t(const loader_output_t& information) : source{ &information }
+{
+	for (const auto& [name, instructions] : information.instructions)
+	{
+		auto text = information.disassembled_code.find(name);
+		if (text == information.disassembled_code.end() || instructions.empty())
+			continue;
+
+		this->code_sections.push_back({ &text->second, &instructions });
+	}
+
+	std::sort(this->code_sections.begin(), this->code_sections.end(), [](const code_section_t& a, const code_section_t& b)
+	{
+		return a.instructions->front().address < b.instructions->front().address;
+	});
+}
+
+static std::int64_t make_handle(std::size_t section, std::size_t index)
+{
+	return (static_cast<std::int64_t>(section) << 32) | static_cast<std::int64_t>(index);
+}
+
+std::int64_t analysis_database_t::first_instruction(std::uint32_t address) const
+{
+	for (std::size_t section = 0; section < this->code_sections.size(); ++section)
+	{
+		const std::vector<instruction_t>& instructions = *this->code_sections[section].instructions;
+		if (instructions.back().address < address)
+			continue;
+
+		auto found = std::lower_bound(instructions.begin(), instructions.end(), address,
+			[](const instruction_t& instruction, std::uint32_t value) { return instruction.address < value; });
+
+		return make_handle(section, found - instructions.begin());
+	}
+
+	return -1;
+}
+
+std::int64_t analysis_database_t::next_instruction(std::int64_t handle) const
+{
+	this->instruction(handle); // validates
+
+	std::size_t section = static_cast<std::size_t>(handle >> 32);
+	std::size_t index = static_cast<std::size_t>(handle & 0xFFFFFFFF) + 1;
+
+	if (index < this->code_sections[section].instructions->size())
+		return make_handle(section, index);
+	if (section + 1 < this->code_sections.size())
+		return make_handle(section + 1, 0);
+
+	return -1;
+}
+
+const instruction_t& analysis_database_t::instruction(std::int64_t handle) const
+{
+	std::size_t section = static_cast<std::size_t>(handle >> 32);
+	std::size_t index = static_cast<std::size_t>(handle & 0xFFFFFFFF);
+
+	if (handle < 0 || section >= this->code_sections.size() || index >= this->code_sections[section].instructions->size())
+		throw std::runtime_error("Invalid instruction handle!");
+
+	return (*this->code_sections[section].instructions)[index];
+}
+
+std::string_view analysis_database_t::instruction_text(std::int64_t handle) const
+{
+	const instruction_t& instruction = this->instruction(handle);
+	return std::string_view{ *this->code_sections[static_cast<std::size_t>(handle >> 32)].text }.substr(instruction.text_offset, instruction.text_length);
+}
+
+std::uint32_t analysis_database_t::to_mapped(std::int64_t virtual_address) const
+{
+	return static_cast<std::uint32_t>(virtual_address - this->source->image_base + this->source->mapped_base);
+}
+
+void analysis_database_t::build_xrefs()
+{
+	PROFILE_SCOPE("analysis_database_t::build_xrefs");
+
+	std::uint64_t mapped_start = this->source->mapped_base;
+	std::uint64_t mapped_end = mapped_start + this->source->image_size;
+	std::uint64_t virtual_start = this->source->image_base;
+	std::uint64_t virtual_end = virtual_start + this->source->image_size;
+
+	for (std::size_t section = 0; section < this->code_sections.size(); ++section)
+	{
+		const std::vector<instruction_t>& instructions = *this->code_sections[section].instructions;
+		for (std::size_t i = 0; i < instructions.size(); ++i)
+		{
+			const instruction_t& instruction = instructions[i];
+			for (std::uint8_t c = 0; c < instruction.constant_count; ++c)
+			{
+				std::uint64_t constant = static_cast<std::uint64_t>(instruction.constants[c]);
+				if (std::find(instruction.constants, instruction.constants + c, instruction.constants[c]) != instruction.constants + c)
+					continue;
+
+				// Branch targets are already mapped, absolute addresses (mov eax, [0x403000]) still use the preferred base
+				std::uint32_t target = 0;
+				if (constant >= mapped_start && constant < mapped_end)
+					target = static_cast<std::uint32_t>(constant);
+				else if (constant >= virtual_start && constant < virtual_end)
+					target = this->to_mapped(static_cast<std::int64_t>(constant));
+				else
+					continue;
+
+				this->xrefs[target].push_back(make_handle(section, i));
+			}
+		}
+	}
+}
+
+const std::vector<std::int64_t>& analysis_database_t::xrefs_to(std::uint32_t address)
+{
+	std::call_once(this->xrefs_built, [this]() { this->build_xrefs(); });
+
+	auto found = this->xrefs.find(address);
+	return found != this->xrefs.end() ? found->second : no_xrefs;
+}
+
+void analysis_database_t::read(std::uint32_t address, void* buffer, std::size_t size) const
+{
+	std::memcpy(buffer, this->view(address, size), size);
+}
+
+const std::uint8_t* analysis_database_t::view(std::uint32_t address, std::size_t size) const
+{
+	if (!this->source->image || address < this->source->mapped_base || static_cast<std::uint64_t>(address) + size > static_cast<std::uint64_t>(this->source->mapped_base) + this->source->image_size)
+		throw std::runtime_error("Attempt to read outside of the image!");
+
+	return this->source->image + (address - this->source->mapped_base);
+}
+
+// The natives below are plain functions (so bind_native can take them), they find the document through this.
+static thread_local script_api::scope_t* current_scope = nullptr;
+
+script_api::scope_t::scope_t(analysis_database_t& database, thread_pool_t* pool, execution_state_t* state) : previous{ current_scope }, database{ database }, pool{ pool }, state{ state }
+{
+	current_scope = this;
+}
+
+script_api::scope_t::~scope_t()
+{
+	current_scope = this->previous;
+}
+
+static analysis_database_t& database()
+{
+	if (!current_scope)
+		throw std::runtime_error("No binary is loaded!");
+
+	return current_scope->database;
+}
+
+template <typename type>
+static const type& table_entry(const std::vector<type>& table, std::int64_t index)
+{
+	if (index < 0 || static_cast<std::uint64_t>(index) >= table.size())
+		throw std::runtime_error("Index " + std::to_string(index) + " is out of range (" + std::to_string(table.size()) + " entries)");
+
+	return table[static_cast<std::size_t>(index)];
+}
+
+template <typename type>
+static type read_image(std::int64_t address)
+{
+	type value{};
+	database().read(static_cast<std::uint32_t>(address), &value, sizeof(value));
+	return value;
+}
+
+// Arrays over the mapped image (see script_arrays.hpp), nothing is copied and they can't be written
+static value_t image_view(std::string_view type, std::int64_t address, std::int64_t count)
+{
+	array_type_t element = script_arrays::array_type(type);
+	if (count < 0 || static_cast<std::uint64_t>(count) > database().source->image_size / array_element_sizes[element])
+		throw std::runtime_error("Attempt to read outside of the image!");
+
+	std::size_t size = static_cast<std::size_t>(count);
+	return value_t::make<runtime_array_t>(element, database().view(static_cast<std::uint32_t>(address), size * array_element_sizes[element]), size);
+}
+
+static std::int64_t image_base() { return database().source->image_base; }
+static std::int64_t mapped_base() { return database().source->mapped_base; }
+static std::int64_t to_mapped(std::int64_t virtual_address) { return database().to_mapped(virtual_address); }
+
+static std::int64_t section_count() { return database().source->sections.size(); }
+static std::string section_name(std::int64_t index) { return table_entry(database().source->sections, index).name; }
+static std::int64_t section_start(std::int64_t index) { return table_entry(database().source->sections, index).start_address; }
+static std::int64_t section_end(std::int64_t index) { return table_entry(database().source->sections, index).end_address; }
+
+static value_t section_view(std::int64_t index)
+{
+	const section_info_t& section = table_entry(database().source->sections, index);
+	std::size_t size = section.end_address > section.start_address ? section.end_address - section.start_address : 0;
+	return value_t::make<runtime_array_t>(ARRAY_U8, database().view(section.start_address, size), size);
+}
+
+static std::int64_t import_count() { return database().source->imports.size(); }
+static std::string import_name(std::int64_t index) { return table_entry(database().source->imports, index).name; }
+static std::string import_module(std::int64_t index) { return table_entry(database().source->imports, index).module; }
+static std::int64_t import_address(std::int64_t index) { return table_entry(database().source->imports, index).thunk_address; }
+
+static std::int64_t export_count() { return database().source->exports.size(); }
+static std::string export_name(std::int64_t index) { return table_entry(database().source->exports, index).name; }
+static std::int64_t export_address(std::int64_t index) { return table_entry(database().source->exports, index).address; }
+
+static std::int64_t first_instruction(std::int64_t address) { return database().first_instruction(static_cast<std::uint32_t>(address)); }
+static std::int64_t next_instruction(std::int64_t handle) { return database().next_instruction(handle); }
+static std::int64_t instruction_address(std::int64_t handle) { return database().instruction(handle).address; }
+static std::int64_t instruction_length(std::int64_t handle) { return database().instruction(handle).length; }
+static std::string instruction_text(std::int64_t handle) { return std::string{ database().instruction_text(handle) }; }
+static std::string instruction_mnemonic(std::int64_t handle)
+{
+	const char* name = ZydisMnemonicGetString(static_cast<ZydisMnemonic>(database().instruction(handle).mnemonic));
+	return name ? name : "";
+}
+
+// Strings are joined with +, these read them. Indices are in bytes, out of range ones are clamped instead of throwing.
+static std::int64_t length(const value_t& value)
+{
+	if (value.type == RUNTIME_ARRAY)
+		return value.as_array().count;
+	if (value.type != RUNTIME_STRING)
+		native::argument_error(0, "string or array", value);
+
+	return value.as_string().size(); // known without flattening a rope
+}
+
+static std::string substring(std::string_view text, std::int64_t start, std::int64_t count)
+{
+	std::size_t first = static_cast<std::size_t>(std::clamp<std::int64_t>(start, 0, text.size()));
+	return std::string{ text.substr(first, static_cast<std::size_t>(std::max<std::int64_t>(count, 0))) };
+}
+
+static std::int64_t find(std::string_view text, std::string_view needle)
+{
+	std::size_t found = text.find(needle);
+	return found == std::string_view::npos ? -1 : static_cast<std::int64_t>(found);
+}
+
+static std::string hex(std::int64_t value)
+{
+	char text[24];
+	std::snprintf(text, sizeof(text), "0x%llX", static_cast<unsigned long long>(value));
+	return text;
+}
+
+static value_t to_string(const value_t& value)
+{
+	char text[32];
+	switch (value.type)
+	{
+		case RUNTIME_STRING:
+			return value;
+		case RUNTIME_INTEGER:
+			std::snprintf(text, sizeof(text), "%lld", static_cast<long long>(value.integer));
+			break;
+		case RUNTIME_NUMBER:
+			std::snprintf(text, sizeof(text), "%g", value.number);
+			break;
+		case RUNTIME_FUNCTION:
+			return value_t::make<runtime_string_t>(value.as_function().debug_name);
+		default:
+			return value_t::make<runtime_string_t>(type_strings[value.type]);
+	}
+
+	return value_t::make<runtime_string_t>(std::string{ text });
+}
+
+// One parallel_map, shared by every thread working on it. Items are handed out one at a time through next,
+// results go straight into their own slot so nothing is locked while running. Helpers that only start once it's over find nothing to do.
+struct parallel_job_t
+{
+	analysis_database_t* database = nullptr;
+	std::shared_ptr<environment_t> environment{};	// not written while the job runs, every worker runs on its own copy
+	value_t function{};
+	std::int64_t count = 0;
+	std::uint64_t max_instructions = 0;				// per item
+	const std::atomic<bool>* cancelled = nullptr;
+
+	std::atomic<std::int64_t> next = 0;
+	std::atomic<bool> failed = false;
+	std::vector<value_t> results{};
+
+	std::mutex mutex{};
+	std::condition_variable idle{};
+	std::size_t helpers = 0;	// pool workers inside work()
+	bool closed = false;		// every item was handed out, no new helpers
+	std::string error{};
+
+	void work()
+	{
+		execution_state_t state{ .global_env = this->environment->copy() };
+		state.max_instructions = this->max_instructions;
+		state.cancelled = this->cancelled;
+		script_api::scope_t scope{ *this->database, nullptr, &state }; // no pool, a parallel_map inside runs on this thread
+
+		for (std::int64_t i = this->next++; i < this->count && !this->failed; i = this->next++)
+		{
+			try
+			{
+				value_t argument{ i };
+				this->results[i] = interpreter::call_function(this->function, &argument, 1, state);
+			}
+			catch (std::exception& err)
+			{
+				std::lock_guard lock{ this->mutex };
+				if (!this->failed.exchange(true))
+					this->error = "parallel_map item " + std::to_string(i) + ": " + err.what();
+			}
+		}
+	}
+
+	void help()
+	{
+		{
+			std::lock_guard lock{ this->mutex };
+			if (this->closed)
+				return;
+
+			++this->helpers;
+		}
+
+		this->work();
+
+		{
+			std::lock_guard lock{ this->mutex };
+			--this->helpers;
+		}
+		this->idle.notify_all();
+	}
+};
+
+constexpr std::int64_t max_parallel_items = 1 << 24;
+
+// parallel_map(count, function) calls function(0) ... function(count - 1) on every pool worker at once, map_result(index) gives back what each returned.
+// Workers start from a copy of the script's variables, what they assign stays in their copy.
+static std::int64_t parallel_map(std::int64_t count, const value_t& function)
+{
+	if (!current_scope || !current_scope->state)
+		throw std::runtime_error("parallel_map can only be used from a running script!");
+	if (count < 0 || count > max_parallel_items)
+		throw std::runtime_error("parallel_map takes 0 to " + std::to_string(max_parallel_items) + " items, got " + std::to_string(count));
+	if (function.type != RUNTIME_FUNCTION)
+		throw std::runtime_error("parallel_map needs a function to call!");
+
+	script_api::scope_t& scope = *current_scope;
+
+	std::shared_ptr<parallel_job_t> job = std::make_shared<parallel_job_t>();
+	job->database = &scope.database;
+	job->environment = scope.state->global_env;
+	job->function = function;
+	job->count = count;
+	job->max_instructions = scope.state->max_instructions;
+	job->cancelled = scope.state->cancelled;
+	job->results.resize(static_cast<std::size_t>(count));
+
+	// The calling thread works too, so this finishes even when every worker is busy (or is this thread)
+	if (scope.pool)
+	{
+		std::size_t helpers = std::min<std::size_t>(scope.pool->size(), static_cast<std::size_t>(count));
+		for (std::size_t i = 0; i < helpers; ++i)
+			scope.pool->submit([job]() { job->help(); });
+	}
+
+	job->work();
+
+	{
+		std::unique_lock lock{ job->mutex };
+		job->closed = true;
+		job->idle.wait(lock, [&job]() { return job->helpers == 0; });
+	}
+
+	if (job->failed)
+		throw std::runtime_error(job->error);
+
+	scope.results = std::move(job->results);
+	return count;
+}
+
+static value_t map_result(std::int64_t index)
+{
+	if (!current_scope)
+		throw std::runtime_error("map_result can only be used from a running script!");
+
+	return table_entry(current_scope->results, index);
+}
+
+static std::int64_t xref_count(std::int64_t address) { return database().xrefs_to(static_cast<std::uint32_t>(address)).size(); }
+static std::int64_t xref(std::int64_t address, std::int64_t index) { return table_entry(database().xrefs_to(static_cast<std::uint32_t>(address)), index); }
+
+void script_api::register_natives(environment_t& environment)
+{
+	environment.assign("image_base", bind_native<&image_base>("image_base"));
+	environment.assign("mapped_base", bind_native<&mapped_base>("mapped_base"));
+	environment.assign("to_mapped", bind_native<&to_mapped>("to_mapped"));
+
+	environment.assign("read_u8", bind_native<&read_image<std::uint8_t>>("read_u8"));
+	environment.assign("read_u16", bind_native<&read_image<std::uint16_t>>("read_u16"));
+	environment.assign("read_u32", bind_native<&read_image<std::uint32_t>>("read_u32"));
+	environment.assign("read_i32", bind_native<&read_image<std::int32_t>>("read_i32"));
+	environment.assign("read_u64", bind_native<&read_image<std::uint64_t>>("read_u64"));
+	environment.assign("image_view", bind_native<&image_view>("image_view"));
+
+	environment.assign("section_count", bind_native<&section_count>("section_count"));
+	environment.assign("section_name", bind_native<&section_name>("section_name"));
+	environment.assign("section_start", bind_native<&section_start>("section_start"));
+	environment.assign("section_end", bind_native<&section_end>("section_end"));
+	environment.assign("section_view", bind_native<&section_view>("section_view"));
+
+	environment.assign("import_count", bind_native<&import_count>("import_count"));
+	environment.assign("import_name", bind_native<&import_name>("import_name"));
+	environment.assign("import_module", bind_native<&import_module>("import_module"));
+	environment.assign("import_address", bind_native<&import_address>("import_address"));
+
+	environment.assign("export_count", bind_native<&export_count>("export_count"));
+	environment.assign("export_name", bind_native<&export_name>("export_name"));
+	environment.assign("export_address", bind_native<&export_address>("export_address"));
+
+	environment.assign("first_instruction", bind_native<&first_instruction>("first_instruction"));
+	environment.assign("next_instruction", bind_native<&next_instruction>("next_instruction"));
+	environment.assign("instruction_address", bind_native<&instruction_address>("instruction_address"));
+	environment.assign("instruction_length", bind_native<&instruction_length>("instruction_length"));
+	environment.assign("instruction_text", bind_native<&instruction_text>("instruction_text"));
+	environment.assign("instruction_mnemonic", bind_native<&instruction_mnemonic>("instruction_mnemonic"));
+
+	environment.assign("xref_count", bind_native<&xref_count>("xref_count"));
+	environment.assign("xref", bind_native<&xref>("xref"));
+
+	environment.assign("length", bind_native<&length>("length"));
+	environment.assign("substring", bind_native<&substring>("substring"));
+	environment.assign("find", bind_native<&find>("find"));
+	environment.assign("hex", bind_native<&hex>("hex"));
+	environment.assign("to_string", bind_native<&to_string>("to_string"));
+
+	script_arrays::register_natives(environment);
+
+	environment.assign("parallel_map", bind_native<&parallel_map>("parallel_map"));
+	environment.assign("map_result", bind_native<&map_result>("map_result"));
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "loader/loader_output.hpp"
+#include "compiler/interpreter/include/basetypes.hpp"
+#include "common/thread_pool.hpp"
+
+// Read only view over one document's analysis for scripts. Nothing gets copied out of loader_output_t,
+// instructions are handed to scripts as integer handles ((code section << 32) | index) pointing straight into the tables.
+class analysis_database_t
+{
+private:
+	struct code_section_t
+	{
+		const std::string* text = nullptr;
+		const std::vector<instruction_t>* instructions = nullptr;
+	};
+
+	std::vector<code_section_t> code_sections{};	// Sorted by address
+	std::unordered_map<std::uint32_t, std::vector<std::int64_t>> xrefs{};	// Target -> every instruction referencing it, built on first use
+	std::once_flag xrefs_built{};
+
+	void build_xrefs();
+public:
+	const loader_output_t* source = nullptr;
+
+	analysis_database_t(const loader_output_t& information);
+	analysis_database_t(const analysis_database_t&) = delete;
+
+	std::int64_t first_instruction(std::uint32_t address) const;	// First instruction at or after address, -1 if there's none
+	std::int64_t next_instruction(std::int64_t handle) const;		// -1 after the last one
+	const instruction_t& instruction(std::int64_t handle) const;	// throws on bad handles
+	std::string_view instruction_text(std::int64_t handle) const;
+	const std::vector<std::int64_t>& xrefs_to(std::uint32_t address);
+
+	std::uint32_t to_mapped(std::int64_t virtual_address) const;	// Absolute addresses in the code use the preferred image base
+	void read(std::uint32_t address, void* buffer, std::size_t size) const;
+	const std::uint8_t* view(std::uint32_t address, std::size_t size) const; // straight into the mapped image, it lives as long as the document
+};
+
+namespace script_api
+{
+	// Natives reach the database (and what parallel_map needs) through this, it's set for as long as the scope lives (per thread).
+	class scope_t
+	{
+	private:
+		scope_t* previous = nullptr;
+	public:
+		analysis_database_t& database;
+		thread_pool_t* pool = nullptr;			// parallel_map runs on the calling thread only without one
+		execution_state_t* state = nullptr;		// script running on this thread, parallel_map copies its variables for every worker
+		std::vector<value_t> results{};			// of the last parallel_map, read by map_result
+
+		scope_t(analysis_database_t& database, thread_pool_t* pool = nullptr, execution_state_t* state = nullptr);
+		scope_t(const scope_t&) = delete;
+		~scope_t();
+	};
+
+	void register_natives(environment_t& environment);
+}
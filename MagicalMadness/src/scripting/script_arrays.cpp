@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <stdexcept>
+
+#include "script_arrays.hpp"
+#include "compiler/interpreter/include/native.hpp"
+
+// Every kernel is written once for all four element types, work gets a value of the array's type to tell which one it is.
+template <typename work_t>
+static decltype(auto) dispatch(array_type_t element, work_t&& work)
+{
+	switch (element)
+	{
+		case ARRAY_U8:
+			return work(std::uint8_t{});
+		case ARRAY_U32:
+			return work(std::uint32_t{});
+		case ARRAY_U64:
+			return work(std::uint64_t{});
+		default:
+			return work(double{});
+	}
+}
+
+// Views of the image aren't aligned to anything, elements are only ever read & written through these
+template <typename type>
+static type load(const std::uint8_t* at)
+{
+	type value;
+	std::memcpy(&value, at, sizeof(type));
+	return value;
+}
+
+template <typename type>
+static void store(std::uint8_t* at, type value)
+{
+	std::memcpy(at, &value, sizeof(type));
+}
+
+// Numbers become integer elements the way the CPU would truncate them, bigger integers wrap
+template <typename type>
+static type to_element(const value_t& value)
+{
+	if constexpr (std::is_same_v<type, double>)
+		return value.type == RUNTIME_INTEGER ? static_cast<double>(value.integer) : static_cast<double>(value.number);
+	else
+		return static_cast<type>(value.type == RUNTIME_INTEGER ? value.integer : static_cast<std::int64_t>(value.number));
+}
+
+template <typename type>
+static value_t element_value(type element)
+{
+	if constexpr (std::is_same_v<type, double>)
+		return static_cast<float>(element);
+	else
+		return static_cast<std::int64_t>(element);
+}
+
+static void check_number(const value_t& value, std::size_t index)
+{
+	if (value.type != RUNTIME_INTEGER && value.type != RUNTIME_NUMBER)
+		native::argument_error(index, "number", value);
+}
+
+static std::size_t check_index(const runtime_array_t& array, std::int64_t index)
+{
+	if (index < 0 || static_cast<std::uint64_t>(index) >= array.count)
+		throw std::runtime_error("Index " + std::to_string(index) + " is out of range (" + std::to_string(array.count) + " elements)");
+
+	return static_cast<std::size_t>(index);
+}
+
+// Fills the whole array with its first size bytes, doubling what's copied every time
+static void repeat(runtime_array_t& array, std::size_t size)
+{
+	for (std::size_t filled = size; filled < array.bytes();)
+	{
+		std::size_t copy = std::min(filled, array.bytes() - filled);
+		std::memcpy(array.writable + filled, array.writable, copy);
+		filled += copy;
+	}
+}
+
+array_type_t script_arrays::array_type(std::string_view name)
+{
+	for (std::size_t i = 0; i < std::size(array_type_strings); ++i)
+	{
+		if (name == array_type_strings[i])
+			return static_cast<array_type_t>(i);
+	}
+
+	throw std::runtime_error("Unknown array type \"" + std::string{ name } + "\", expected u8, u32, u64 or f64");
+}
+
+static value_t make_array(array_type_t element, std::int64_t count)
+{
+	if (count < 0 || static_cast<std::uint64_t>(count) > script_arrays::max_array_bytes / array_element_sizes[element])
+		throw std::runtime_error("Arrays hold up to " + std::to_string(script_arrays::max_array_bytes >> 20) + "MB, got " + std::to_string(count) + " " + array_type_strings[element] + " elements");
+
+	return value_t::make<runtime_array_t>(element, static_cast<std::size_t>(count));
+}
+
+// array("u8", 4096) is zeroed
+static value_t array(std::string_view type, std::int64_t count)
+{
+	return make_array(script_arrays::array_type(type), count);
+}
+
+static value_t array_get(const runtime_array_t& array, std::int64_t index)
+{
+	std::size_t at = check_index(array, index) * array.element_size();
+	return dispatch(array.element, [&](auto tag) { return element_value(load<decltype(tag)>(array.data + at)); });
+}
+
+static void array_set(const runtime_array_t& array, std::int64_t index, const value_t& value)
+{
+	if (!array.writable)
+		throw std::runtime_error("Views of the image are read only, array_copy makes one that can be written!");
+
+	std::size_t at = check_index(array, index) * array.element_size();
+	check_number(value, 2);
+	dispatch(array.element, [&](auto tag) { store(array.writable + at, to_element<decltype(tag)>(value)); });
+}
+
+static value_t array_copy(const runtime_array_t& array)
+{
+	value_t copy = value_t::make<runtime_array_t>(array.element, array.count);
+	std::memcpy(copy.as_array().writable, array.data, array.bytes());
+	return copy;
+}
+
+// Shares the elements, out of range parts are cut off like substring
+static value_t array_slice(const runtime_array_t& source, std::int64_t first, std::int64_t count)
+{
+	std::size_t start = static_cast<std::size_t>(std::clamp<std::int64_t>(first, 0, source.count));
+	std::size_t size = static_cast<std::size_t>(std::clamp<std::int64_t>(count, 0, source.count - start));
+	return value_t::make<runtime_array_t>(source, start, size);
+}
+
+static value_t string_to_array(std::string_view text)
+{
+	value_t bytes = make_array(ARRAY_U8, text.size());
+	std::memcpy(bytes.as_array().writable, text.data(), text.size());
+	return bytes;
+}
+
+static std::string array_to_string(const runtime_array_t& array)
+{
+	return std::string{ reinterpret_cast<const char*>(array.data), array.bytes() };
+}
+
+template <typename type>
+static __m128i vector_add(__m128i a, __m128i b)
+{
+	if constexpr (std::is_same_v<type, std::uint8_t>)
+		return _mm_add_epi8(a, b);
+	else if constexpr (std::is_same_v<type, std::uint32_t>)
+		return _mm_add_epi32(a, b);
+	else if constexpr (std::is_same_v<type, std::uint64_t>)
+		return _mm_add_epi64(a, b);
+	else
+		return _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+}
+
+template <typename type>
+static __m128i vector_subtract(__m128i a, __m128i b)
+{
+	if constexpr (std::is_same_v<type, std::uint8_t>)
+		return _mm_sub_epi8(a, b);
+	else if constexpr (std::is_same_v<type, std::uint32_t>)
+		return _mm_sub_epi32(a, b);
+	else if constexpr (std::is_same_v<type, std::uint64_t>)
+		return _mm_sub_epi64(a, b);
+	else
+		return _mm_castpd_si128(_mm_sub_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+}
+
+// SSE2 has no byte or 32 bit multiply, both are made of the wider ones. 64 bit is done per element.
+template <typename type>
+static __m128i vector_multiply(__m128i a, __m128i b)
+{
+	if constexpr (std::is_same_v<type, std::uint8_t>)
+	{
+		__m128i even = _mm_mullo_epi16(a, b);
+		__m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+		return _mm_or_si128(_mm_and_si128(even, _mm_set1_epi16(0xFF)), _mm_slli_epi16(odd, 8));
+	}
+	else if constexpr (std::is_same_v<type, std::uint32_t>)
+	{
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+	else if constexpr (std::is_same_v<type, std::uint64_t>)
+	{
+		std::uint64_t left[2], right[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(left), a);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(right), b);
+
+		std::uint64_t products[2] = { left[0] * right[0], left[1] * right[1] };
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(products));
+	}
+	else
+		return _mm_castpd_si128(_mm_mul_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+}
+
+// 16 bytes at a time, what's left over one element at a time. right may be out.
+template <typename type, typename vector_t, typename scalar_t>
+static void combine(std::uint8_t* out, const std::uint8_t* left, const std::uint8_t* right, std::size_t count, vector_t vector, scalar_t scalar)
+{
+	constexpr std::size_t lanes = sizeof(__m128i) / sizeof(type);
+
+	std::size_t i = 0;
+	for (; i + lanes <= count; i += lanes)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i * sizeof(type)));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i * sizeof(type)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(type)), vector(a, b));
+	}
+
+	for (; i < count; ++i)
+		store<type>(out + i * sizeof(type), scalar(load<type>(left + i * sizeof(type)), load<type>(right + i * sizeof(type))));
+}
+
+template <typename type>
+static void combine(binary_operator_t operand, std::uint8_t* out, const std::uint8_t* left, const std::uint8_t* right, std::size_t count)
+{
+	switch (operand)
+	{
+		case BINARY_ADD:
+			return combine<type>(out, left, right, count, vector_add<type>, [](type a, type b) { return static_cast<type>(a + b); });
+		case BINARY_SUBTRACT:
+			return combine<type>(out, left, right, count, vector_subtract<type>, [](type a, type b) { return static_cast<type>(a - b); });
+		case BINARY_MULTIPLY:
+			return combine<type>(out, left, right, count, vector_multiply<type>, [](type a, type b) { return static_cast<type>(a * b); });
+		default:
+			break;
+	}
+
+	if constexpr (std::is_integral_v<type>)
+	{
+		switch (operand)
+		{
+			case BINARY_AND:
+				return combine<type>(out, left, right, count, [](__m128i a, __m128i b) { return _mm_and_si128(a, b); }, [](type a, type b) { return static_cast<type>(a & b); });
+			case BINARY_OR:
+				return combine<type>(out, left, right, count, [](__m128i a, __m128i b) { return _mm_or_si128(a, b); }, [](type a, type b) { return static_cast<type>(a | b); });
+			case BINARY_XOR:
+				return combine<type>(out, left, right, count, [](__m128i a, __m128i b) { return _mm_xor_si128(a, b); }, [](type a, type b) { return static_cast<type>(a ^ b); });
+			default:
+				break;
+		}
+	}
+}
+
+// array_xor(Data, 0x5A) or array_xor(Data, Key): the right side is one number for every element, or an array of the same type
+// that repeats when it's shorter (a key of a few bytes). Always makes a new array, views of the image stay as they are.
+static value_t element_wise(binary_operator_t operand, const runtime_array_t& left, const value_t& right)
+{
+	if (left.element == ARRAY_F64 && operand >= BINARY_AND)
+		throw std::runtime_error("attempt to " + binary_operator_strings[operand] + " f64 array");
+
+	value_t result = value_t::make<runtime_array_t>(left.element, left.count);
+	runtime_array_t& out = result.as_array();
+	if (!left.count)
+		return result;
+
+	const std::uint8_t* source = out.writable;
+	if (right.type == RUNTIME_ARRAY)
+	{
+		const runtime_array_t& pattern = right.as_array();
+		if (pattern.element != left.element)
+			throw std::runtime_error("attempt to " + binary_operator_strings[operand] + " " + array_type_strings[left.element] + " array and " + array_type_strings[pattern.element] + " array");
+		if (pattern.count == 0 || pattern.count > left.count)
+			throw std::runtime_error("The right array needs 1 to " + std::to_string(left.count) + " elements, it has " + std::to_string(pattern.count));
+
+		if (pattern.count == left.count)
+			source = pattern.data;
+		else
+		{
+			std::memcpy(out.writable, pattern.data, pattern.bytes());
+			repeat(out, pattern.bytes());
+		}
+	}
+	else
+	{
+		if (right.type != RUNTIME_INTEGER && right.type != RUNTIME_NUMBER)
+			native::argument_error(1, "number or array", right);
+
+		dispatch(left.element, [&](auto tag) { store(out.writable, to_element<decltype(tag)>(right)); });
+		repeat(out, out.element_size());
+	}
+
+	dispatch(left.element, [&](auto tag) { combine<decltype(tag)>(operand, out.writable, left.data, source, left.count); });
+	return result;
+}
+
+template <binary_operator_t operand>
+static value_t array_operator(const runtime_array_t& left, const value_t& right)
+{
+	return element_wise(operand, left, right);
+}
+
+// Integers wrap like the CPU would, f64 arrays give a number
+static value_t array_sum(const runtime_array_t& array)
+{
+	return dispatch(array.element, [&](auto tag) -> value_t
+	{
+		using type = decltype(tag);
+		constexpr std::size_t lanes = sizeof(__m128i) / sizeof(type);
+
+		std::size_t i = 0;
+		if constexpr (std::is_same_v<type, double>)
+		{
+			__m128d total = _mm_setzero_pd();
+			for (; i + lanes <= array.count; i += lanes)
+				total = _mm_add_pd(total, _mm_loadu_pd(reinterpret_cast<const double*>(array.data + i * sizeof(type))));
+
+			double halves[2];
+			_mm_storeu_pd(halves, total);
+			double sum = halves[0] + halves[1];
+			for (; i < array.count; ++i)
+				sum += load<type>(array.data + i * sizeof(type));
+
+			return static_cast<float>(sum);
+		}
+		else
+		{
+			// Added up in 64 bit lanes, bytes 8 at a time by sad (their distance from 0), u32s widened first
+			__m128i zero = _mm_setzero_si128();
+			__m128i total = zero;
+			for (; i + lanes <= array.count; i += lanes)
+			{
+				__m128i elements = _mm_loadu_si128(reinterpret_cast<const __m128i*>(array.data + i * sizeof(type)));
+				if constexpr (std::is_same_v<type, std::uint8_t>)
+					total = _mm_add_epi64(total, _mm_sad_epu8(elements, zero));
+				else if constexpr (std::is_same_v<type, std::uint32_t>)
+					total = _mm_add_epi64(_mm_add_epi64(total, _mm_unpacklo_epi32(elements, zero)), _mm_unpackhi_epi32(elements, zero));
+				else
+					total = _mm_add_epi64(total, elements);
+			}
+
+			std::uint64_t halves[2];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(halves), total);
+			std::uint64_t sum = halves[0] + halves[1];
+			for (; i < array.count; ++i)
+				sum += load<type>(array.data + i * sizeof(type));
+
+			return static_cast<std::int64_t>(sum);
+		}
+	});
+}
+
+// First index at or after start holding value, -1 when there's none
+static std::int64_t array_find(const runtime_array_t& array, const value_t& value, std::int64_t start)
+{
+	check_number(value, 1);
+
+	return dispatch(array.element, [&](auto tag) -> std::int64_t
+	{
+		using type = decltype(tag);
+		constexpr std::size_t lanes = sizeof(__m128i) / sizeof(type);
+
+		type needle = to_element<type>(value);
+		type needles[lanes];
+		std::fill(std::begin(needles), std::end(needles), needle);
+		__m128i wanted = _mm_loadu_si128(reinterpret_cast<const __m128i*>(needles));
+
+		// One bit per element that matched
+		auto matches = [&](__m128i elements) -> int
+		{
+			if constexpr (std::is_same_v<type, std::uint8_t>)
+				return _mm_movemask_epi8(_mm_cmpeq_epi8(elements, wanted));
+			else if constexpr (std::is_same_v<type, std::uint32_t>)
+				return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(elements, wanted)));
+			else if constexpr (std::is_same_v<type, std::uint64_t>)
+			{
+				__m128i halves = _mm_cmpeq_epi32(elements, wanted); // no 64 bit compare in SSE2, both halves have to match
+				return _mm_movemask_pd(_mm_castsi128_pd(_mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)))));
+			}
+			else
+				return _mm_movemask_pd(_mm_cmpeq_pd(_mm_castsi128_pd(elements), _mm_castsi128_pd(wanted)));
+		};
+
+		std::size_t i = static_cast<std::size_t>(std::clamp<std::int64_t>(start, 0, array.count));
+		for (; i + lanes <= array.count; i += lanes)
+		{
+			if (int found = matches(_mm_loadu_si128(reinterpret_cast<const __m128i*>(array.data + i * sizeof(type)))))
+				return static_cast<std::int64_t>(i + std::countr_zero(static_cast<unsigned int>(found)));
+		}
+
+		for (; i < array.count; ++i)
+		{
+			if (load<type>(array.data + i * sizeof(type)) == needle)
+				return static_cast<std::int64_t>(i);
+		}
+
+		return -1;
+	});
+}
+
+// Bytes only. Four tables so runs of the same byte don't wait on each other's increments.
+static void count_bytes(const runtime_array_t& array, std::uint64_t (&counts)[256])
+{
+	if (array.element != ARRAY_U8)
+		throw std::runtime_error("Only u8 arrays can be counted, got " + array_type_strings[array.element]);
+
+	std::vector<std::uint32_t> tables(4 * 256);
+	const std::uint8_t* data = array.data;
+
+	std::size_t i = 0;
+	for (; i + 4 <= array.count; i += 4)
+	{
+		++tables[data[i]];
+		++tables[256 + data[i + 1]];
+		++tables[512 + data[i + 2]];
+		++tables[768 + data[i + 3]];
+	}
+	for (; i < array.count; ++i)
+		++tables[data[i]];
+
+	for (std::size_t byte = 0; byte < 256; ++byte)
+		counts[byte] = static_cast<std::uint64_t>(tables[byte]) + tables[256 + byte] + tables[512 + byte] + tables[768 + byte];
+}
+
+// u64 array of how often each byte value shows up
+static value_t array_histogram(const runtime_array_t& array)
+{
+	std::uint64_t counts[256];
+	count_bytes(array, counts);
+
+	value_t histogram = value_t::make<runtime_array_t>(ARRAY_U64, 256);
+	std::memcpy(histogram.as_array().writable, counts, sizeof(counts));
+	return histogram;
+}
+
+// Bits per byte, 0 (one value repeated) to 8 (random or compressed/encrypted)
+static float array_entropy(const runtime_array_t& array)
+{
+	std::uint64_t counts[256];
+	count_bytes(array, counts);
+
+	double entropy = 0.0;
+	for (std::uint64_t count : counts)
+	{
+		if (!count)
+			continue;
+
+		double share = static_cast<double>(count) / array.count;
+		entropy -= share * std::log2(share);
+	}
+
+	return static_cast<float>(entropy);
+}
+
+void script_arrays::register_natives(environment_t& environment)
+{
+	environment.assign("array", bind_native<&array>("array"));
+	environment.assign("array_get", bind_native<&array_get>("array_get"));
+	environment.assign("array_set", bind_native<&array_set>("array_set"));
+	environment.assign("array_copy", bind_native<&array_copy>("array_copy"));
+	environment.assign("array_slice", bind_native<&array_slice>("array_slice"));
+	environment.assign("string_to_array", bind_native<&string_to_array>("string_to_array"));
+	environment.assign("array_to_string", bind_native<&array_to_string>("array_to_string"));
+
+	environment.assign("array_add", bind_native<&array_operator<BINARY_ADD>>("array_add"));
+	environment.assign("array_subtract", bind_native<&array_operator<BINARY_SUBTRACT>>("array_subtract"));
+	environment.assign("array_multiply", bind_native<&array_operator<BINARY_MULTIPLY>>("array_multiply"));
+	environment.assign("array_and", bind_native<&array_operator<BINARY_AND>>("array_and"));
+	environment.assign("array_or", bind_native<&array_operator<BINARY_OR>>("array_or"));
+	environment.assign("array_xor", bind_native<&array_operator<BINARY_XOR>>("array_xor"));
+
+	environment.assign("array_sum", bind_native<&array_sum>("array_sum"));
+	environment.assign("array_find", bind_native<&array_find>("array_find"));
+	environment.assign("array_histogram", bind_native<&array_histogram>("array_histogram"));
+	environment.assign("array_entropy", bind_native<&array_entropy>("array_entropy"));
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string_view>
+
+#include "compiler/interpreter/include/basetypes.hpp"
+
+// Typed arrays for scripts working on whole byte ranges (decoding, checksums, entropy). One native call runs over every element
+// with SSE2 instead of the interpreter dispatching once per byte.
+//
+//	Data = section_view(0); Key = string_to_array("key"); Decoded = array_xor(Data, Key); array_entropy(Data);
+namespace script_arrays
+{
+	constexpr std::size_t max_array_bytes = 1 << 28;
+
+	array_type_t array_type(std::string_view name); // "u8", "u32", "u64" or "f64", throws on anything else
+
+	void register_natives(environment_t& environment);
+}
@@ -0,0 +1,154 @@
+#include "script_runner.hpp"
+#include "profiler/profiler.hpp"
+#include "compiler/interpreter/include/native.hpp"
+
+std::int32_t HelloComputer()
+{
+	std::printf("Hello I am on the C++ side! This went through the scripting languages interpreter into a native C++ call, to here.\n");
+	return 1;
+}
+
+void print(const value_t& value)
+{
+	value.dump();
+}
+
+script_runner_t::script_runner_t(thread_pool_t& pool) : pool{ pool }, state{ .global_env = std::make_shared<environment_t>() }
+{
+	this->state.global_env->assign("HelloComputer", bind_native<&HelloComputer>("HelloComputer")); // Expose C++ function to my language
+	this->state.global_env->assign("print", bind_native<&print>("print"));
+	script_api::register_natives(*this->state.global_env);
+}
+
+script_runner_t::~script_runner_t()
+{
+	this->stop();
+}
+
+void script_runner_t::run(const std::string& source, analysis_database_t* database)
+{
+	PROFILE_SCOPE("script_runner_t::run");
+
+	script_api::scope_t scope{ *database, &this->pool, &this->state }; // natives read this document's analysis, parallel_map uses the pool
+
+	this->state.max_instructions = this->limits.max_instructions;
+	this->state.cancelled = &this->cancelled;
+	this->state.profile = this->limits.profile ? &this->profile : nullptr;
+	this->state.instructions = 0;
+	this->profile.clear();
+
+	try
+	{
+		std::shared_ptr<const script_t> compiled = this->scripts.get(source); // Running the same text again skips lexing, parsing & compiling
+		compiled->run(this->state);
+
+		std::printf("Script ran successfully!\n");
+		this->status = "Finished";
+		this->failed = false;
+	}
+	catch (std::exception& err)
+	{
+		std::printf("Script failed!\n%s\n", err.what());
+		this->status = this->timed_out ? "Stopped by the time limit" : err.what();
+		this->failed = true;
+	}
+
+	char summary[96];
+	std::snprintf(summary, sizeof(summary), " in %.3fms, %llu instructions", this->elapsed_milliseconds(), static_cast<unsigned long long>(this->state.instructions));
+	this->status += summary;
+
+	// The environment outlives the database, nothing may keep pointing into it
+	this->state.stack.clear();
+	this->state.frames.clear();
+}
+
+void script_runner_t::start(const std::string& source, analysis_database_t& database, const script_limits_t& limits)
+{
+	this->stop();
+
+	static bool warn = false;
+	if (!warn)
+	{
+		warn = true;
+		std::printf("[WARNING]: Error messages are bad - not fully added yet; most will come with semantic analysis pass once I add it.\n");
+	}
+
+	this->status.clear();
+	this->limits = limits;
+	this->cancelled = false;
+	this->timed_out = false;
+	this->running = true;
+	this->started = std::chrono::steady_clock::now();
+	this->job = this->pool.submit([this, source, database = &database]() { this->run(source, database); });
+}
+
+void script_runner_t::stop()
+{
+	this->cancelled = true;
+	if (this->job.valid())
+		this->job.get();
+
+	this->running = false;
+}
+
+void script_runner_t::cancel()
+{
+	if (this->running)
+		this->cancelled = true;
+}
+
+bool script_runner_t::poll()
+{
+	if (!this->running)
+		return false;
+
+	if (this->job.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready)
+	{
+		this->job.get();
+		this->running = false;
+		return false;
+	}
+
+	if (this->limits.max_milliseconds && this->elapsed_milliseconds() >= this->limits.max_milliseconds && !this->cancelled)
+	{
+		this->timed_out = true;
+		this->cancelled = true;
+	}
+
+	return true;
+}
+
+bool script_runner_t::is_running() const
+{
+	return this->running;
+}
+
+double script_runner_t::elapsed_milliseconds() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->started).count();
+}
+
+void script_runner_t::set_cache_directory(const std::string& path)
+{
+	this->scripts.set_directory(path);
+}
+
+const std::string& script_runner_t::get_status() const
+{
+	return this->status;
+}
+
+bool script_runner_t::has_failed() const
+{
+	return this->failed;
+}
+
+const script_cache_t& script_runner_t::get_cache() const
+{
+	return this->scripts;
+}
+
+const script_profile_t& script_runner_t::get_profile() const
+{
+	return this->profile;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <string>
+
+#include "scripting/script_api.hpp"
+#include "compiler/script/script.hpp"
+#include "compiler/interpreter/include/profile.hpp"
+#include "common/thread_pool.hpp"
+
+struct script_limits_t
+{
+	std::uint64_t max_instructions = 0;	// 0 = no limit
+	std::uint32_t max_milliseconds = 0;	// 0 = no limit
+	bool profile = false;
+};
+
+// Runs Scripting Suite scripts on the worker pool so a runaway one can't freeze the UI, one at a time.
+// Variables are kept between runs like before. The time limit is kept by poll(), it cancels the script once it's over.
+class script_runner_t
+{
+private:
+	thread_pool_t& pool;
+	std::future<void> job{};
+	std::atomic<bool> cancelled = false;
+	std::atomic<bool> timed_out = false;
+	bool running = false;
+
+	script_limits_t limits{};
+	std::chrono::steady_clock::time_point started{};
+
+	// Only touched by the worker while running (start() waits for the previous job first), by the UI thread otherwise
+	execution_state_t state;
+	script_cache_t scripts{};
+	std::string status{};
+	bool failed = false;
+	script_profile_t profile{};
+
+	void run(const std::string& source, analysis_database_t* database);
+	void stop(); // cancels and waits for the job
+public:
+	script_runner_t(thread_pool_t& pool);
+	script_runner_t(const script_runner_t&) = delete;
+	~script_runner_t();
+
+	void start(const std::string& source, analysis_database_t& database, const script_limits_t& limits);
+	void cancel(); // doesn't wait, the script stops at its next check and poll() picks it up
+	bool poll(); // call once a frame, false once nothing is running
+	bool is_running() const;
+	double elapsed_milliseconds() const;
+
+	void set_cache_directory(const std::string& path); // compiled scripts are kept there too, not while running
+
+	const std::string& get_status() const;		// result of the last run, empty while running
+	bool has_failed() const;					// last run threw (or was stopped)
+	const script_cache_t& get_cache() const;
+	const script_profile_t& get_profile() const;	// of the last run when it was profiled
+};
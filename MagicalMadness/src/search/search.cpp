@@ -0,0 +1,321 @@
+#ifndef ZYDIS_STATIC_BUILD
+#define ZYDIS_STATIC_BUILD
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+
+#include "search.hpp"
+#include "profiler/profiler.hpp"
+#include <Zydis/Zydis.h>
+
+constexpr std::size_t publish_batch_size = 4096; // hits handed to the UI at once, also how often cancellation is checked
+
+// Zydis only goes id -> name, these go the other way. Built once on first use.
+static const std::unordered_map<std::string, std::uint16_t>& mnemonic_ids()
+{
+	static const std::unordered_map<std::string, std::uint16_t> ids = []()
+	{
+		std::unordered_map<std::string, std::uint16_t> output{};
+		for (std::int32_t i = ZYDIS_MNEMONIC_INVALID + 1; i <= ZYDIS_MNEMONIC_MAX_VALUE; ++i)
+		{
+			if (const char* name = ZydisMnemonicGetString(static_cast<ZydisMnemonic>(i)))
+				output.emplace(name, static_cast<std::uint16_t>(i));
+		}
+		return output;
+	}();
+
+	return ids;
+}
+
+static const std::unordered_map<std::string, std::uint16_t>& register_ids()
+{
+	static const std::unordered_map<std::string, std::uint16_t> ids = []()
+	{
+		std::unordered_map<std::string, std::uint16_t> output{};
+		for (std::int32_t i = ZYDIS_REGISTER_NONE + 1; i <= ZYDIS_REGISTER_MAX_VALUE; ++i)
+		{
+			if (const char* name = ZydisRegisterGetString(static_cast<ZydisRegister>(i)))
+				output.emplace(name, static_cast<std::uint16_t>(i));
+		}
+		return output;
+	}();
+
+	return ids;
+}
+
+static std::string to_lower(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return text;
+}
+
+void search_index_t::build(const loader_output_t& information, const std::atomic<bool>& cancelled)
+{
+	this->source = nullptr;
+	this->sections.clear();
+	this->by_mnemonic.clear();
+	this->by_register.clear();
+	this->by_constant.clear();
+
+	for (const auto& [name, instructions] : information.instructions)
+	{
+		auto text = information.disassembled_code.find(name);
+		if (text == information.disassembled_code.end())
+			continue;
+
+		this->sections.push_back({ &name, &text->second, &instructions });
+	}
+
+	for (std::uint32_t section = 0; section < this->sections.size(); ++section)
+	{
+		const std::vector<instruction_t>& instructions = *this->sections[section].instructions;
+		for (std::uint32_t i = 0; i < instructions.size(); ++i)
+		{
+			if (i % publish_batch_size == 0 && cancelled)
+				return; // source stays null so the next query rebuilds
+
+			const instruction_t& instruction = instructions[i];
+			this->by_mnemonic[instruction.mnemonic].push_back({ section, i });
+
+			for (std::uint8_t r = 0; r < instruction.register_count; ++r)
+			{
+				// "mov eax, [eax+4]" should only be one hit
+				if (std::find(instruction.registers, instruction.registers + r, instruction.registers[r]) == instruction.registers + r)
+					this->by_register[instruction.registers[r]].push_back({ section, i });
+			}
+
+			for (std::uint8_t c = 0; c < instruction.constant_count; ++c)
+			{
+				if (std::find(instruction.constants, instruction.constants + c, instruction.constants[c]) == instruction.constants + c)
+					this->by_constant[instruction.constants[c]].push_back({ section, i });
+			}
+		}
+	}
+
+	this->source = &information;
+}
+
+search_t::~search_t()
+{
+	this->cancel();
+}
+
+bool search_t::parse_query(search_kind_t kind, const std::string& input, search_query_t& query)
+{
+	query.kind = kind;
+	std::string needle = to_lower(input);
+
+	switch (kind)
+	{
+		case SEARCH_MNEMONIC:
+		case SEARCH_REGISTER:
+		{
+			const auto& ids = kind == SEARCH_MNEMONIC ? mnemonic_ids() : register_ids();
+			auto found = ids.find(needle);
+			if (found == ids.end())
+			{
+				this->error = "Unknown " + to_lower(search_kind_strings[kind]) + ": \"" + input + "\"";
+				return false;
+			}
+
+			query.value = found->second;
+			if (kind == SEARCH_REGISTER) // index stores enclosing registers only
+			{
+				ZydisRegister enclosing = ZydisRegisterGetLargestEnclosing(ZYDIS_MACHINE_MODE_LEGACY_32, static_cast<ZydisRegister>(query.value));
+				if (enclosing != ZYDIS_REGISTER_NONE)
+					query.value = enclosing;
+			}
+			return true;
+		}
+		case SEARCH_CONSTANT:
+		{
+			char* end = nullptr;
+			query.value = std::strtoll(needle.c_str(), &end, 0); // base 0 takes 0x prefixes
+			if (needle.empty() || *end != '\0')
+			{
+				this->error = "Invalid constant: \"" + input + "\"";
+				return false;
+			}
+
+			// Constants are stored zero extended (see disassembler.cpp), -16 is found as 0xFFFFFFF0 like the listing shows it
+			if (query.value < 0 && query.value >= INT32_MIN)
+				query.value = static_cast<std::uint32_t>(query.value);
+			return true;
+		}
+		case SEARCH_TEXT:
+		{
+			if (needle.empty())
+			{
+				this->error = "Nothing to search for.";
+				return false;
+			}
+
+			query.text = std::move(needle);
+			return true;
+		}
+		default:
+			this->error = "Unknown search kind.";
+			return false;
+	}
+}
+
+void search_t::start(const loader_output_t& information, search_kind_t kind, const std::string& input)
+{
+	this->cancel();
+
+	this->hits.clear();
+	this->pending.clear();
+	this->error.clear();
+
+	search_query_t query{};
+	if (!this->parse_query(kind, input, query))
+		return;
+
+	this->cancelled = false;
+	this->running = true;
+	this->job = this->pool.submit([this, information = &information, query = std::move(query)]() { this->run(information, query); });
+}
+
+void search_t::cancel()
+{
+	this->cancelled = true;
+	if (this->job.valid())
+		this->job.get();
+
+	this->running = false;
+}
+
+bool search_t::is_running() const
+{
+	return this->running;
+}
+
+void search_t::publish(std::vector<search_hit_t>& batch)
+{
+	if (batch.empty())
+		return;
+
+	std::lock_guard lock{ this->pending_mutex };
+	this->pending.insert(this->pending.end(), batch.begin(), batch.end());
+	batch.clear();
+}
+
+void search_t::run(const loader_output_t* information, const search_query_t& query)
+{
+	PROFILE_SCOPE("search_t::run");
+	if (this->index.source != information)
+		this->index.build(*information, this->cancelled);
+
+	if (!this->cancelled)
+	{
+		std::vector<search_hit_t> batch{};
+		batch.reserve(publish_batch_size);
+
+		// Posting lists are already sorted by (section, index), so just stream them out in chunks.
+		auto stream = [&](const auto& table, auto key)
+		{
+			auto found = table.find(key);
+			if (found == table.end())
+				return;
+
+			const std::vector<search_hit_t>& list = found->second;
+			for (std::size_t i = 0; i < list.size() && !this->cancelled; i += publish_batch_size)
+			{
+				batch.assign(list.begin() + i, list.begin() + std::min(list.size(), i + publish_batch_size));
+				this->publish(batch);
+			}
+		};
+
+		switch (query.kind)
+		{
+			case SEARCH_MNEMONIC:
+				stream(this->index.by_mnemonic, static_cast<std::uint16_t>(query.value));
+				break;
+			case SEARCH_REGISTER:
+				stream(this->index.by_register, static_cast<std::uint16_t>(query.value));
+				break;
+			case SEARCH_CONSTANT:
+				stream(this->index.by_constant, query.value);
+				break;
+			case SEARCH_TEXT:
+			{
+				// Search the whole listing at once instead of line by line, then map each match back to its instruction.
+				auto equal = [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); };
+				auto hash = [](char c) { return static_cast<std::size_t>(std::tolower(static_cast<unsigned char>(c))); };
+				std::boyer_moore_horspool_searcher searcher{ query.text.begin(), query.text.end(), hash, equal };
+
+				for (std::uint32_t section = 0; section < this->index.sections.size() && !this->cancelled; ++section)
+				{
+					const std::string& text = *this->index.sections[section].text;
+					const std::vector<instruction_t>& instructions = *this->index.sections[section].instructions;
+
+					auto position = text.begin();
+					while (!this->cancelled)
+					{
+						auto match = std::search(position, text.end(), searcher);
+						if (match == text.end())
+							break;
+
+						std::uint32_t offset = static_cast<std::uint32_t>(match - text.begin());
+						auto owner = std::upper_bound(instructions.begin(), instructions.end(), offset,
+							[](std::uint32_t value, const instruction_t& instruction) { return value < instruction.text_offset; });
+
+						if (owner != instructions.begin())
+						{
+							--owner;
+							batch.push_back({ section, static_cast<std::uint32_t>(owner - instructions.begin()) });
+							if (batch.size() >= publish_batch_size)
+								this->publish(batch);
+
+							// One hit per line is enough
+							position = text.begin() + owner->text_offset + owner->text_length;
+						}
+						else
+							position = match + 1;
+					}
+				}
+
+				this->publish(batch);
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	this->running = false;
+}
+
+// Called once a frame by the UI, moves everything the worker found since last time into the visible list.
+const std::vector<search_hit_t>& search_t::poll()
+{
+	std::lock_guard lock{ this->pending_mutex };
+	if (!this->pending.empty())
+	{
+		this->hits.insert(this->hits.end(), this->pending.begin(), this->pending.end());
+		this->pending.clear();
+	}
+
+	return this->hits;
+}
+
+std::string_view search_t::line(const search_hit_t& hit) const
+{
+	const search_index_t::section_view_t& section = this->index.sections[hit.section];
+	const instruction_t& instruction = (*section.instructions)[hit.index];
+
+	return std::string_view{ *section.text }.substr(instruction.text_offset, instruction.text_length);
+}
+
+std::string_view search_t::section_name(const search_hit_t& hit) const
+{
+	return *this->index.sections[hit.section].name;
+}
+
+const std::string& search_t::get_error()
+{
+	return this->error;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "loader/loader_output.hpp"
+#include "common/thread_pool.hpp"
+
+enum search_kind_t : std::int32_t
+{
+	SEARCH_MNEMONIC,	// exact mnemonic, "mov"
+	SEARCH_CONSTANT,	// immediate or displacement, "0x401000" / "-8"
+	SEARCH_REGISTER,	// register (matches every sub register too), "eax"
+	SEARCH_TEXT			// case insensitive substring of the formatted listing
+};
+
+const char* const search_kind_strings[] = {
+	"Mnemonic",
+	"Constant",
+	"Register",
+	"Text"
+};
+
+struct search_query_t
+{
+	search_kind_t kind = SEARCH_MNEMONIC;
+	std::int64_t value = 0;	// Mnemonic, register or constant
+	std::string text{};		// Lowercased needle for SEARCH_TEXT
+};
+
+// 8 bytes so millions of hits stay cheap.
+struct search_hit_t
+{
+	std::uint32_t section = 0;	// Index into search_t's section list
+	std::uint32_t index = 0;	// Index into that section's instructions
+};
+
+// Inverted tables over every instruction of one loader output. Built once (on a pool worker) then reused by every query.
+class search_index_t
+{
+public:
+	struct section_view_t
+	{
+		const std::string* name = nullptr;
+		const std::string* text = nullptr;
+		const std::vector<instruction_t>* instructions = nullptr;
+	};
+
+	const loader_output_t* source = nullptr;
+	std::vector<section_view_t> sections{};
+	std::unordered_map<std::uint16_t, std::vector<search_hit_t>> by_mnemonic{};
+	std::unordered_map<std::uint16_t, std::vector<search_hit_t>> by_register{};
+	std::unordered_map<std::int64_t, std::vector<search_hit_t>> by_constant{};
+
+	void build(const loader_output_t& information, const std::atomic<bool>& cancelled);
+};
+
+// Runs one query at a time on the worker pool, hits are streamed back to the UI thread through poll().
+class search_t
+{
+private:
+	thread_pool_t& pool;
+	std::future<void> job{};
+	std::atomic<bool> cancelled = false;
+	std::atomic<bool> running = false;
+
+	std::mutex pending_mutex{};
+	std::vector<search_hit_t> pending{};	// Filled by the worker, drained by poll()
+	std::vector<search_hit_t> hits{};		// Only touched by the UI thread
+
+	search_index_t index{};					// Written by the worker only (start() waits for the previous job first)
+	std::string error{};
+
+	bool parse_query(search_kind_t kind, const std::string& input, search_query_t& query);
+	void run(const loader_output_t* information, const search_query_t& query);
+	void publish(std::vector<search_hit_t>& batch);
+public:
+	search_t(thread_pool_t& pool) : pool{ pool } {};
+	search_t(const search_t&) = delete;
+	~search_t();
+
+	void start(const loader_output_t& information, search_kind_t kind, const std::string& query);
+	void cancel();
+	bool is_running() const;
+
+	const std::vector<search_hit_t>& poll();
+	std::string_view line(const search_hit_t& hit) const;
+	std::string_view section_name(const search_hit_t& hit) const;
+	const std::string& get_error();
+};
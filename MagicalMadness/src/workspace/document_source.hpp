@@ -0,0 +1,13 @@
+#pragma once
+#include "loader/loader_output.hpp"
+
+// Whatever produces a document's analysis. loader_t on Windows, a synthetic listing in the headless benchmark.
+// Both functions run on the worker pool.
+class document_source_t
+{
+public:
+	virtual ~document_source_t() = default;
+
+	virtual void analyze(loader_output_t& output) = 0;		// Full analysis, runs once when the document is opened
+	virtual void disassemble(loader_output_t& output) = 0;	// Rebuilds only the listing (after it was evicted)
+};
@@ -0,0 +1,207 @@
+#include <algorithm>
+
+#include "workspace.hpp"
+#include "profiler/profiler.hpp"
+#include "dependencies/imgui/imgui.h"
+
+void document_t::wait()
+{
+	if (this->job.valid())
+		this->job.get();
+}
+
+// Only what eviction can give back, the PE summary is tiny and always kept.
+std::size_t document_t::listing_bytes() const
+{
+	std::size_t bytes = 0;
+	for (const auto& [section, text] : this->output->disassembled_code)
+		bytes += text.capacity();
+	for (const auto& [section, instructions] : this->output->instructions)
+		bytes += instructions.capacity() * sizeof(instruction_t);
+
+	return bytes;
+}
+
+workspace_t::~workspace_t()
+{
+	for (std::unique_ptr<document_t>& document : this->documents)
+		document->wait();
+}
+
+void workspace_t::open(const std::string& path)
+{
+	std::unique_ptr<document_t> document = std::make_unique<document_t>();
+	document->path = path;
+	document->title = path.substr(path.find_last_of("\\/") + 1);
+	document->source = this->opener(path);
+
+	document_t* target = document.get();
+	document->job = this->pool.submit([target]()
+	{
+		try
+		{
+			target->source->analyze(*target->output);
+		}
+		catch (std::exception& err)
+		{
+			target->output->output += "Analysis failed: ";
+			target->output->output += err.what();
+		}
+
+		target->state = DOCUMENT_READY;
+	});
+
+	this->documents.push_back(std::move(document));
+	this->active = this->documents.size() - 1;
+}
+
+// Lazily builds whatever the document needs to be shown, never blocks the UI thread.
+void workspace_t::activate(document_t& document)
+{
+	document.last_shown = this->frame;
+
+	if (document.state == DOCUMENT_EVICTED)
+	{
+		document.wait();
+		document.state = DOCUMENT_ANALYZING;
+
+		document_t* target = &document;
+		document.job = this->pool.submit([target]()
+		{
+			target->source->disassemble(*target->output);
+			target->state = DOCUMENT_READY;
+		});
+	}
+
+	if (document.state == DOCUMENT_READY && !document.views)
+		document.views = std::make_unique<views_t>(this->pool);
+}
+
+void workspace_t::enforce_memory_budget()
+{
+	std::size_t total = 0;
+	for (const std::unique_ptr<document_t>& document : this->documents)
+	{
+		if (document->state == DOCUMENT_READY)
+			total += document->listing_bytes();
+	}
+
+	while (total > this->memory_budget)
+	{
+		// Least recently shown ready document that isn't the active tab
+		document_t* victim = nullptr;
+		for (std::size_t i = 0; i < this->documents.size(); ++i)
+		{
+			document_t* document = this->documents[i].get();
+			if (i == this->active || document->state != DOCUMENT_READY)
+				continue;
+
+			if (!victim || document->last_shown < victim->last_shown)
+				victim = document;
+		}
+
+		if (!victim)
+			return; // Only the active document is left, it's allowed to go over
+
+		PROFILE_SCOPE("workspace_t::enforce_memory_budget (evict)");
+		total -= victim->listing_bytes();
+
+		victim->views.reset(); // Cancels its search, the search index points into the listing
+		victim->output->disassembled_code = {};
+		victim->output->instructions = {};
+		victim->state = DOCUMENT_EVICTED;
+	}
+}
+
+void workspace_t::close(std::size_t index)
+{
+	document_t& document = *this->documents[index];
+	document.wait();
+	document.views.reset();
+
+	this->documents.erase(this->documents.begin() + index);
+	if (index < this->active)
+		--this->active;
+	else if (this->active >= this->documents.size())
+		this->active = this->documents.empty() ? 0 : this->documents.size() - 1;
+}
+
+bool workspace_t::render()
+{
+	PROFILE_SCOPE("workspace_t::render");
+	++this->frame;
+
+	std::size_t closing = this->documents.size();
+
+	ImGui::Begin("Workspace");
+
+		ImGui::SetNextItemWidth(-60.f);
+		bool submitted = ImGui::InputTextWithHint("##open_path", "Path of a binary to add to the workspace", this->open_path, sizeof(this->open_path), ImGuiInputTextFlags_EnterReturnsTrue);
+		ImGui::SameLine();
+		if ((ImGui::Button("Open") || submitted) && this->open_path[0])
+		{
+			this->open(this->open_path);
+			this->open_path[0] = '\0';
+		}
+
+		if (ImGui::BeginTabBar("##documents", ImGuiTabBarFlags_AutoSelectNewTabs | ImGuiTabBarFlags_FittingPolicyScroll))
+		{
+			for (std::size_t i = 0; i < this->documents.size(); ++i)
+			{
+				document_t& document = *this->documents[i];
+				bool keep_open = true;
+
+				ImGui::PushID(&document); // Documents are heap allocated, the id survives tabs before it closing
+				if (ImGui::BeginTabItem(document.title.c_str(), &keep_open))
+				{
+					this->active = i;
+					ImGui::TextUnformatted(document.path.c_str());
+					switch (document.state)
+					{
+						case DOCUMENT_ANALYZING:
+							ImGui::TextUnformatted("Analyzing...");
+							break;
+						case DOCUMENT_EVICTED:
+							ImGui::TextUnformatted("Rebuilding listing...");
+							break;
+						default:
+							ImGui::Text("Listing: %.1f MB", document.listing_bytes() / (1024.f * 1024.f));
+							break;
+					}
+					ImGui::EndTabItem();
+				}
+				ImGui::PopID();
+
+				if (!keep_open)
+					closing = i;
+			}
+
+			ImGui::EndTabBar();
+		}
+
+		if (ImGui::IsKeyPressed(ImGuiKey_F3, false))
+			this->profiler_open = !this->profiler_open;
+		ImGui::Checkbox("Profiler (F3)", &this->profiler_open);
+
+	ImGui::End();
+
+	if (closing < this->documents.size())
+		this->close(closing);
+
+	bool keep_running = true;
+	if (this->documents.empty())
+		keep_running = this->placeholder_views->render(this->placeholder);
+	else
+	{
+		document_t& document = *this->documents[this->active];
+		this->activate(document);
+
+		if (document.views)
+			keep_running = document.views->render(*document.output);
+	}
+
+	profiler::render_overlay(&this->profiler_open);
+	this->enforce_memory_budget();
+
+	return keep_running;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "document_source.hpp"
+#include "common/thread_pool.hpp"
+#include "interface/views.hpp"
+
+enum document_state_t : std::uint8_t
+{
+	DOCUMENT_ANALYZING,	// a pool job owns the output right now
+	DOCUMENT_READY,
+	DOCUMENT_EVICTED	// listing & views were dropped to stay under the memory budget, rebuilt when the tab is opened again
+};
+
+struct document_t
+{
+	std::string path{};
+	std::string title{};
+	std::unique_ptr<document_source_t> source{};
+	std::unique_ptr<loader_output_t> output = std::make_unique<loader_output_t>(); // Everything analysis produced for this document, nothing is shared with other documents
+	std::unique_ptr<views_t> views{};		// Built the first time the document is shown
+	std::atomic<document_state_t> state = DOCUMENT_ANALYZING;
+	std::future<void> job{};
+	std::uint64_t last_shown = 0;			// Frame the document was last the active tab, used to pick eviction victims
+
+	void wait();
+	std::size_t listing_bytes() const;
+};
+
+using document_opener_t = std::function<std::unique_ptr<document_source_t>(const std::string& path)>;
+
+// Every open binary (an EXE and the DLLs it loads for example), shown as tabs that share one render loop and one worker pool.
+class workspace_t
+{
+private:
+	thread_pool_t pool{}; // Declared first so it outlives every document's jobs
+	std::vector<std::unique_ptr<document_t>> documents{};
+	std::size_t active = 0;
+	std::uint64_t frame = 0;
+
+	document_opener_t opener{};
+	loader_output_t placeholder{};			// Shown while nothing is open
+	std::unique_ptr<views_t> placeholder_views = std::make_unique<views_t>(this->pool);
+	char open_path[260]{ 0 };
+	bool profiler_open = false;
+
+	void activate(document_t& document);
+	void enforce_memory_budget();
+	void close(std::size_t index);
+public:
+	std::size_t memory_budget = 512ull * 1024 * 1024; // Formatted listings of inactive documents get evicted past this
+
+	workspace_t(document_opener_t opener) : opener{ std::move(opener) } {};
+	workspace_t(const workspace_t&) = delete;
+	~workspace_t();
+
+	void open(const std::string& path);
+	bool render(); // Must be called between ImGui::NewFrame and ImGui::Render, returns false once the user closed the tool
+};